@@ -0,0 +1,332 @@
+// Times lexing, parsing and printing a file separately, e.g., a corpus from gardenia-gen.
+//
+//   gardenia-bench [--repeat N] [--json FILE] [--compare BASELINE] [--threshold PERCENT] FILE
+//
+// Each phase runs in a process of its own, so its peak RSS is its own: the input it needs is made first
+// (nothing for lexing, the tokens for parsing, the AST for printing), untimed, then the peak is reset
+// to what is left, i.e., that input, and the phase runs N times (3 by default), of which the fastest
+// counts. Reported for each phase are MB/s of source, tokens/s, AST nodes/s, and the peak RSS. --json
+// saves them, and --compare reads a file saved so and fails if a phase got slower in MB/s, or bigger
+// in RSS, by more than PERCENT (10).
+//
+// Lexing streams, but parsing is timed apart from lexing, so it holds every token, and the tree, in
+// memory: about 30 bytes per byte of source on the generated corpus (450 MB for 16 MB). A corpus of
+// a GB or more needs that much RAM; keep FILE below a thirtieth of it.
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "flat.h"
+#include "json.h"
+#include "parser.h"
+
+using Clock = std::chrono::steady_clock;
+
+enum Phase { LEX, PARSE, PRINT, PHASES };
+static constexpr std::string_view phase_names[PHASES] = {"lex", "parse", "print"};
+
+// What a phase sends back to the parent.
+struct Measure {
+    bool ok;
+    double seconds;       // of the fastest run
+    uint64_t tokens;
+    uint64_t nodes;
+    uint64_t peak_rss;    // in bytes, 0 if unknown
+};
+
+struct Result {
+    double seconds = 0;
+    double mb_per_s = 0;
+    double tokens_per_s = 0;
+    double nodes_per_s = 0;
+    double peak_rss_mb = 0;
+};
+
+// Forget the peak RSS so far, so what the phase needs is measured apart from its input.
+static void reset_peak() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd >= 0) {
+        [[maybe_unused]] ssize_t n = write(fd, "5", 1);
+        close(fd);
+    }
+}
+
+static uint64_t peak_rss() {
+    std::ifstream status("/proc/self/status");
+    for (string line; std::getline(status, line); ) {
+        if (line.starts_with("VmHWM:")) {
+            return std::stoull(line.substr(6)) << 10;
+        }
+    }
+    return 0;
+}
+
+static uint64_t count_nodes(const Program& program) {
+    return flatten(program).nodes.size();
+}
+
+// All the tokens of a file, with the names interned as the parser would, for parsing alone.
+struct Tokens {
+    Lexer lexer;  // owns the decoded literals
+    vector<Token> tokens;
+    Token end;
+    vector<Symbol> names;
+    explicit Tokens(const string& path) : lexer(path, false) {
+        for (Token t = lexer.next(); ; t = lexer.next()) {
+            if (t.type == TT::END) {
+                end = t;
+                break;
+            }
+            tokens.push_back(t);
+        }
+    }
+};
+
+static unique_ptr<Program> parse(Tokens& input) {
+    auto ret = make_unique<Program>();
+    input.names.assign(input.tokens.size(), 0);
+    for (size_t i = 0; i != input.tokens.size(); ++i) {
+        if (input.tokens[i].type == TT::IDENTIFIER) {
+            input.names[i] = ret->symbols.intern(input.tokens[i].value);
+        }
+    }
+    const Token* begin = input.tokens.data();
+    TokenSpan span{begin, begin, begin + input.tokens.size(), input.names.data(), input.end, nullptr};
+    Parser parser(span, false);
+    parser.declarations(ret->arena, ret->decls, ret->spans);
+    return ret;
+}
+
+// Run a phase "repeat" times; in the child process.
+static Measure measure(Phase phase, const string& path, int repeat) {
+    Measure m{true, 0, 0, 0, 0};
+    unique_ptr<Tokens> tokens;
+    unique_ptr<Program> program;
+    if (phase != LEX) {
+        tokens = make_unique<Tokens>(path);
+        m.tokens = tokens->tokens.size();
+        program = parse(*tokens);
+        m.nodes = count_nodes(*program);
+        if (phase == PRINT) {
+            tokens.reset();
+        } else {
+            program.reset();
+        }
+    }
+    reset_peak();
+    int null = open("/dev/null", O_WRONLY);
+    for (int i = 0; i != repeat; ++i) {
+        auto start = Clock::now();
+        switch (phase) {
+            case LEX: {
+                Lexer lexer(path, false);
+                while (lexer.next().type != TT::END) {
+                }
+                m.tokens = lexer.count() - 1;
+                break;
+            }
+            case PARSE:
+                program = parse(*tokens);
+                break;
+            case PRINT: {
+                Output out(null);
+                print_program(*program, out, false);
+                break;
+            }
+            default:
+                break;
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        m.seconds = i == 0 ? seconds : std::min(m.seconds, seconds);
+        if (phase == PARSE) {
+            program.reset();
+        }
+    }
+    close(null);
+    m.peak_rss = peak_rss();
+    return m;
+}
+
+static bool run_phase(Phase phase, const string& path, int repeat, Measure& m) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        Measure result{false, 0, 0, 0, 0};
+        try {
+            result = measure(phase, path, repeat);
+        } catch (const CompileError& e) {
+            cerr << error_text(e, false);
+        }
+        [[maybe_unused]] ssize_t n = write(fds[1], &result, sizeof(result));
+        _exit(0);
+    }
+    close(fds[1]);
+    ssize_t got = pid > 0 ? read(fds[0], &m, sizeof(m)) : -1;
+    close(fds[0]);
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return got == sizeof(m) && m.ok;
+}
+
+// A number after "key": in JSON written by write_results(), or -1.
+static double find_number(std::string_view json, std::string_view key, size_t from = 0) {
+    string quoted = "\"" + string(key) + "\":";
+    size_t at = json.find(quoted, from);
+    if (at == json.npos) {
+        return -1;
+    }
+    return std::strtod(json.data() + at + quoted.size(), nullptr);
+}
+
+static void write_results(Output& out, const string& path, uint64_t bytes, const Measure& input,
+                          const Result (&results)[PHASES]) {
+    JsonWriter json(out);
+    json.raw("{\"input\":{\"file\":");
+    json.string(path);
+    json.raw(",\"bytes\":");
+    json.number(static_cast<long>(bytes));
+    json.raw(",\"tokens\":");
+    json.number(static_cast<long>(input.tokens));
+    json.raw(",\"nodes\":");
+    json.number(static_cast<long>(input.nodes));
+    json.raw("},\"phases\":{");
+    for (int p = 0; p != PHASES; ++p) {
+        const Result& r = results[p];
+        json.raw(p == 0 ? "\"" : ",\"");
+        json.raw(phase_names[p]);
+        json.raw(std::format("\":{{\"seconds\":{:.6f},\"mb_per_s\":{:.3f},\"tokens_per_s\":{:.0f},"
+                             "\"nodes_per_s\":{:.0f},\"peak_rss_mb\":{:.3f}}}",
+                             r.seconds, r.mb_per_s, r.tokens_per_s, r.nodes_per_s, r.peak_rss_mb));
+    }
+    json.raw("}}\n");
+}
+
+// Compare with the results in "baseline"; the number of regressions, or -1 if it cannot be read.
+static int compare(const string& baseline, uint64_t bytes, const Result (&results)[PHASES], double threshold) {
+    std::ifstream file(baseline);
+    if (!file) {
+        return -1;
+    }
+    string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    double base_bytes = find_number(json, "bytes");
+    if (base_bytes < 0) {
+        return -1;
+    }
+    if (static_cast<uint64_t>(base_bytes) != bytes) {
+        cerr << COLOR_ERROR << "warning: " << COLOR_RESET << "the baseline is of another input ("
+             << static_cast<uint64_t>(base_bytes) << " bytes instead of " << bytes << ")" << endl;
+    }
+    int regressions = 0;
+    cout << std::format("\n{:<8}{:>14}{:>14}{:>10}{:>14}{:>14}{:>10}\n",
+                        "vs base", "MB/s", "base", "change", "RSS/MB", "base", "change");
+    for (int p = 0; p != PHASES; ++p) {
+        size_t at = json.find("\"" + string(phase_names[p]) + "\":{");
+        if (at == json.npos) {
+            continue;
+        }
+        double speed = find_number(json, "mb_per_s", at), rss = find_number(json, "peak_rss_mb", at);
+        double speed_change = speed > 0 ? (results[p].mb_per_s / speed - 1) * 100 : 0;
+        double rss_change = rss > 0 ? (results[p].peak_rss_mb / rss - 1) * 100 : 0;
+        cout << std::format("{:<8}{:>14.2f}{:>14.2f}{:>9.1f}%{:>14.1f}{:>14.1f}{:>9.1f}%\n", phase_names[p],
+                            results[p].mb_per_s, speed, speed_change, results[p].peak_rss_mb, rss, rss_change);
+        if (speed_change < -threshold) {
+            cout << std::format("REGRESSION: {} is {:.1f}% slower\n", phase_names[p], -speed_change);
+            ++regressions;
+        }
+        if (rss_change > threshold) {
+            cout << std::format("REGRESSION: {} takes {:.1f}% more memory\n", phase_names[p], rss_change);
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    int repeat = 3;
+    double threshold = 10;
+    string json_path, baseline, path;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--repeat" && has_value) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else if (arg == "--compare" && has_value) {
+            baseline = argv[++i];
+        } else if (arg == "--threshold" && has_value) {
+            threshold = std::atof(argv[++i]);
+        } else if (path.empty() && !arg.starts_with("--")) {
+            path = arg;
+        } else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        cerr << "usage: gardenia-bench [--repeat N] [--json FILE] [--compare BASELINE] [--threshold PERCENT] FILE"
+             << endl;
+        return 2;
+    }
+
+    uint64_t bytes;
+    try {
+        bytes = Source(path).length();
+    } catch (const CompileError& e) {
+        cerr << error_text(e, true);
+        return 1;
+    }
+    Measure measures[PHASES];
+    for (int p = 0; p != PHASES; ++p) {
+        if (!run_phase(static_cast<Phase>(p), path, repeat, measures[p])) {
+            cerr << COLOR_ERROR << "error: " << COLOR_RESET << "cannot " << phase_names[p] << ' ' << path << endl;
+            return 1;
+        }
+    }
+    const Measure& input = measures[PARSE];  // counts the tokens and nodes of the whole file
+
+    Result results[PHASES];
+    cout << std::format("{}: {} bytes, {} tokens, {} AST nodes, best of {}\n",
+                        path, bytes, input.tokens, input.nodes, repeat);
+    cout << std::format("{:<8}{:>12}{:>12}{:>14}{:>14}{:>12}\n",
+                        "phase", "seconds", "MB/s", "tokens/s", "nodes/s", "RSS/MB");
+    for (int p = 0; p != PHASES; ++p) {
+        const Measure& m = measures[p];
+        double seconds = std::max(m.seconds, 1e-9);
+        results[p] = {m.seconds, bytes / seconds / (1 << 20), input.tokens / seconds, input.nodes / seconds,
+                      static_cast<double>(m.peak_rss) / (1 << 20)};
+        const Result& r = results[p];
+        cout << std::format("{:<8}{:>12.4f}{:>12.2f}{:>14.0f}{:>14.0f}{:>12.1f}\n",
+                            phase_names[p], r.seconds, r.mb_per_s, r.tokens_per_s, r.nodes_per_s, r.peak_rss_mb);
+    }
+
+    if (!json_path.empty()) {
+        int fd = open(json_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            cerr << COLOR_ERROR << "error: " << COLOR_RESET << "cannot write " << json_path << endl;
+            return 1;
+        }
+        {
+            Output out(fd);
+            write_results(out, path, bytes, input, results);
+        }
+        close(fd);
+    }
+    if (!baseline.empty()) {
+        int regressions = compare(baseline, bytes, results, threshold);
+        if (regressions < 0) {
+            cerr << COLOR_ERROR << "error: " << COLOR_RESET << "cannot read the baseline " << baseline << endl;
+            return 1;
+        }
+        return regressions == 0 ? 0 : 1;
+    }
+    return 0;
+}
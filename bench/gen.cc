@@ -0,0 +1,420 @@
+// Generates C in the subset gardenia parses, as a corpus for benchmarks.
+//
+//   gardenia-gen SIZE [FILE] [--seed N]
+//
+// SIZE is in bytes, with an optional K, M, or G suffix. Whole declarations are written until there are
+// at least SIZE bytes: globals of every type and declarator, prototypes, and functions whose bodies use
+// every kind of statement, with expressions both deep (nested parentheses, unary operators, ?:) and wide
+// (long runs of one operator). The output depends on SIZE and the seed only, and a smaller SIZE gives a
+// prefix of a larger one.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+using std::string;
+
+class Generator {
+public:
+    Generator(uint64_t seed, FILE* f) : state(seed), file(f) {}
+    void declaration();
+    uint64_t written() const { return total + text.size(); }
+    void flush() {
+        fwrite(text.data(), 1, text.size(), file);
+        total += text.size();
+        text.clear();
+    }
+private:
+    uint64_t state;
+    FILE* file;
+    string text;
+    uint64_t total = 0;
+    unsigned globals = 0;    // g0 ... are declared
+    unsigned functions = 0;  // f0 ... are declared
+    // splitmix64, so the output is the same on every platform
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+    unsigned below(unsigned n) { return static_cast<unsigned>(next() % n); }
+    void put(std::string_view s) { text += s; }
+    void number(uint64_t n) { text += std::to_string(n); }
+    void indent(int level) { text.append(4 * level, ' '); }
+    void type(bool storage, bool can_be_void = true);
+    void declarator(bool parameters);
+    void parameter_list();
+    void initializer(int depth);
+    void name();
+    void atom();
+    void expression(int depth);
+    void deep();
+    void wide();
+    void statement(int depth, int level);
+    void block(int depth, int level);
+};
+
+static constexpr std::string_view binary_ops[] = {
+    "+", "-", "*", "/", "%", "<<", ">>", "<", "<=", ">", ">=", "==", "!=", "&", "^", "|", "&&", "||"
+};
+static constexpr std::string_view assign_ops[] = {
+    "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|="
+};
+static constexpr std::string_view unary_ops[] = {"-", "+", "!", "~", "*", "&", "++", "--", "sizeof"};
+// left-associative operators, for wide expressions
+static constexpr std::string_view run_ops[] = {"+", "*", "&&", "||", "|", "&", "^", ","};
+
+void Generator::type(bool storage, bool can_be_void) {
+    if (storage) {
+        switch (below(8)) {
+            case 0: put("static "); break;
+            case 1: put("extern "); break;
+            default: break;
+        }
+    }
+    switch (below(12)) {
+        case 0: put(can_be_void ? "void" : "long"); break;
+        case 1: put("double"); break;
+        case 2: put("struct S"); number(below(8)); break;
+        case 3: put("unsigned char"); break;
+        case 4: put("char"); break;
+        case 5: put("unsigned int"); break;
+        case 6: put("long"); break;
+        case 7: put("unsigned long"); break;
+        default: put("int"); break;
+    }
+    put(" ");
+}
+
+void Generator::declarator(bool parameters) {
+    for (unsigned stars = below(6) < 4 ? 0 : below(3) + 1; stars != 0; --stars) {
+        put("*");
+    }
+    if (parameters) {
+        put("f");
+        number(functions++);
+        parameter_list();
+        return;
+    }
+    put("g");
+    number(globals++);
+    if (below(5) == 0) {
+        for (unsigned n = below(3) + 1; n != 0; --n) {
+            put("[");
+            number(below(64) + 1);
+            put("]");
+        }
+    }
+}
+
+void Generator::parameter_list() {
+    unsigned n = below(5);
+    if (n == 0) {
+        put("(void)");
+        return;
+    }
+    put("(");
+    for (unsigned i = 0; i != n; ++i) {
+        if (i != 0) {
+            put(", ");
+        }
+        type(false, i != 0);  // "(void" is taken as "(void)"
+        put(below(4) == 0 ? "*p" : "p");
+        number(i);
+    }
+    put(")");
+}
+
+void Generator::initializer(int depth) {
+    if (depth <= 0 || below(3) != 0) {
+        expression(3);
+        return;
+    }
+    put("{");
+    for (unsigned n = below(6) + 1, i = 0; i != n; ++i) {
+        if (i != 0) {
+            put(", ");
+        }
+        initializer(depth - 1);
+    }
+    put(below(4) == 0 ? ", }" : "}");
+}
+
+void Generator::name() {
+    switch (below(4)) {
+        case 0:
+            if (globals != 0) {
+                put("g");
+                number(below(globals));
+                break;
+            }
+            [[fallthrough]];
+        default:
+            put("v");
+            number(below(10));
+            break;
+    }
+}
+
+void Generator::atom() {
+    if (below(3) == 0) {
+        number(below(4) == 0 ? next() % 2147483647 : below(100));
+    } else {
+        name();
+    }
+}
+
+void Generator::expression(int depth) {
+    if (depth <= 0) {
+        atom();
+        return;
+    }
+    unsigned r = below(100);
+    if (r < 25) {
+        atom();
+    } else if (r < 55) {
+        expression(depth - 1);
+        put(" ");
+        put(binary_ops[below(std::size(binary_ops))]);
+        put(" ");
+        expression(depth - 1);
+    } else if (r < 65) {
+        put(unary_ops[below(std::size(unary_ops))]);
+        put(" ");
+        atom();
+    } else if (r < 75) {
+        put("(");
+        expression(depth - 1);
+        put(")");
+    } else if (r < 82) {
+        put("(");
+        expression(depth - 1);
+        put(" ? ");
+        expression(depth - 1);
+        put(" : ");
+        expression(depth - 1);
+        put(")");
+    } else if (r < 90) {
+        put("f");
+        number(functions != 0 ? below(functions) : 0);
+        put("(");
+        for (unsigned n = below(4), i = 0; i != n; ++i) {
+            if (i != 0) {
+                put(", ");
+            }
+            expression(depth - 1);
+        }
+        put(")");
+    } else if (r < 96) {
+        put("(");
+        name();
+        put(" ");
+        put(assign_ops[below(std::size(assign_ops))]);
+        put(" ");
+        expression(depth - 1);
+        put(")");
+    } else if (r < 98) {
+        deep();
+    } else {
+        wide();
+    }
+}
+
+// Nested parentheses and unary operators. Printed trees indent each level, so they are kept to
+// a few dozen levels at most, or the printer would be timed mostly on spaces.
+void Generator::deep() {
+    unsigned levels = below(24) + 8;
+    for (unsigned i = 0; i != levels; ++i) {
+        put(below(2) == 0 ? "(" : "-(");
+    }
+    atom();
+    for (unsigned i = 0; i != levels; ++i) {
+        put(i % 7 == 3 ? " + 1)" : ")");
+    }
+}
+
+// A run of one operator, up to a couple of hundred operands (a tree as deep, unless --n-ary).
+void Generator::wide() {
+    std::string_view op = run_ops[below(std::size(run_ops))];
+    unsigned n = below(16) == 0 ? below(200) + 50 : below(30) + 3;
+    put("(");
+    for (unsigned i = 0; i != n; ++i) {
+        if (i != 0) {
+            put(" ");
+            put(op);
+            put(" ");
+        }
+        atom();
+    }
+    put(")");
+}
+
+void Generator::statement(int depth, int level) {
+    unsigned r = depth <= 0 ? 0 : below(100);
+    indent(level);
+    if (r < 30) {
+        expression(4);
+        put(";\n");
+    } else if (r < 33) {
+        put(";\n");
+    } else if (r < 40) {
+        put("return ");
+        expression(4);
+        put(";\n");
+    } else if (r < 52) {
+        put("if (");
+        expression(3);
+        put(")\n");
+        statement(depth - 1, level + 1);
+        // sometimes a long else-if chain
+        for (unsigned n = below(4) == 0 ? below(20) : below(2); n != 0; --n) {
+            indent(level);
+            put("else if (");
+            expression(3);
+            put(")\n");
+            statement(depth - 1, level + 1);
+        }
+        if (below(2) == 0) {
+            indent(level);
+            put("else\n");
+            statement(depth - 1, level + 1);
+        }
+    } else if (r < 60) {
+        put("while (");
+        expression(3);
+        put(")\n");
+        statement(depth - 1, level + 1);
+    } else if (r < 65) {
+        put("do\n");
+        statement(depth - 1, level + 1);
+        indent(level);
+        put("while (");
+        expression(3);
+        put(");\n");
+    } else if (r < 75) {
+        put("for (");
+        if (below(2) == 0) {
+            put("int v");
+            number(below(10));
+            put(" = ");
+            expression(2);
+            put("; ");
+        } else if (below(3) != 0) {
+            expression(2);
+            put("; ");
+        } else {
+            put("; ");
+        }
+        if (below(4) != 0) {
+            expression(3);
+        }
+        put("; ");
+        if (below(4) != 0) {
+            expression(2);
+        }
+        put(")\n");
+        statement(depth - 1, level + 1);
+    } else if (r < 79) {
+        put("continue;\n");
+    } else if (r < 83) {
+        put("break;\n");
+    } else {
+        text.resize(text.size() - 4 * level);  // the block indents itself
+        block(depth - 1, level);
+    }
+}
+
+void Generator::block(int depth, int level) {
+    indent(level);
+    put("{\n");
+    for (unsigned n = below(8), i = 0; i != n; ++i) {
+        if (below(4) == 0) {
+            indent(level + 1);
+            type(false);
+            if (below(3) == 0) {
+                put("*");
+            }
+            put("v");
+            number(below(10));
+            if (below(2) == 0) {
+                put(" = ");
+                initializer(1);
+            }
+            put(";\n");
+        } else {
+            statement(depth, level + 1);
+        }
+    }
+    indent(level);
+    put("}\n");
+}
+
+void Generator::declaration() {
+    unsigned r = below(100);
+    if (r < 40) {
+        type(true);
+        declarator(false);
+        if (below(2) == 0) {
+            put(" = ");
+            initializer(2);
+        }
+        put(";\n");
+    } else if (r < 50) {
+        type(true);
+        declarator(true);
+        put(";\n");
+    } else {
+        type(below(4) == 0);
+        declarator(true);
+        put("\n");
+        block(4, 0);
+    }
+    if (text.size() >= 1 << 20) {
+        flush();
+    }
+}
+
+static uint64_t parse_size(const char* s) {
+    char* end;
+    uint64_t n = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': return n << 10;
+        case 'm': case 'M': return n << 20;
+        case 'g': case 'G': return n << 30;
+        default: return n;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t size = 0;
+    uint64_t seed = 1;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (size == 0) {
+            size = parse_size(argv[i]);
+        } else {
+            path = argv[i];
+        }
+    }
+    if (size == 0) {
+        fprintf(stderr, "usage: gardenia-gen SIZE[K|M|G] [FILE] [--seed N]\n");
+        return 2;
+    }
+    FILE* file = path ? fopen(path, "wb") : stdout;
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+    Generator gen(seed, file);
+    while (gen.written() < size) {
+        gen.declaration();
+    }
+    gen.flush();
+    return fclose(file) == 0 ? 0 : 1;
+}
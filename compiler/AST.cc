@@ -1,3 +1,4 @@
+#include<algorithm>
 #include<variant>
 
 #include "error.h"
@@ -7,297 +8,421 @@
 // Notes:
 // 1. CType, Declarator, and Parameter are printed inline, while others are printed on separate lines.
 // 2. Each node executes "indent_push()" for its child nodes and "cur -= 2" for itself.
-//    Thus, every version of the virtual function "print" (except for the one in class Program) 
-//    needs to end with "cur -= (ending ? 2 : 0)".
-// 3. The function "print_component" will execute "indent_push()" once.
-//    Thus, if both "indent_push()" and "print_component(...)" are executed,
-//    an additional "cur -= 2" should be executed at the end.
-//    In my code, I let the function "print" end with "cur -= (ending ? 4 : 2)" instead in this situation.
+//    Thus, every node (except for Program) schedules "dedent(ending ? 2 : 0)" after its children.
+// 3. A component executes "indent_push()" once.
+//    Thus, if both "indent_push()" and a component are executed,
+//    an additional "cur -= 2" is needed at the end, i.e., "dedent(ending ? 4 : 2)".
+// 4. A node prints its own line at once and schedules the rest (components, children, dedent) as tasks,
+//    which are run in order after it; no printing function calls itself for a child node.
 
-vector<int> AST::indent = {};
-int AST::cur = 0;
-
-// Print indentation and execute indent.pop_back() if reaching the end.
-void AST::print_indent(bool ending) {
+// Print indentation and execute indent_pop() if reaching the end.
+template <bool Color>
+void Printer<Color>::print_indent(bool ending) {
     // box-drawing characters: │ ├ └ ─
-    int lst = 0;
-    cout << string(indent[0] - lst, ' ');
-    lst = indent[0] + 1;
-    for (size_t i = 1; i != indent.size(); ++i) {
-        cout << "│" << string(indent[i] - lst, ' ');
-        lst = indent[i] + 1;
-    }
-    cout << (ending ? "└" : "├");
-    for (; lst < cur; ++lst) {
-        cout << "─";
+    out << prefix << (ending ? "└" : "├");
+    for (int lst = indent.back() + 1; lst < cur; ++lst) {
+        out << "─";
     }
     if (ending) {
-        indent.pop_back();
+        indent_pop();
         // pop is executed automatically, but "cur -= 2" needs to be executed manually.
     }
 }
 
 // Record current indentation.
-void AST::indent_push() {
+// The connector column that was last so far gets a "│", which stays until that column is popped.
+template <bool Color>
+void Printer<Color>::indent_push() {
+    marks.push_back(prefix.size());
+    if (indent.empty()) {
+        prefix.append(cur, ' ');
+    } else {
+        prefix += "│";
+        prefix.append(std::max(cur - indent.back() - 1, 0), ' ');
+    }
     indent.push_back(cur);
     cur += 2;
 }
 
-// Print the name of component, then execute indent_push().
-void AST::print_component(string name, bool ending) {
-    print_indent(ending);
-    cout << COLOR_COMPONENT << name << COLOR_RESET << endl;
-    indent_push();
+template <bool Color>
+void Printer<Color>::indent_pop() {
+    indent.pop_back();
+    prefix.resize(marks.back());
+    marks.pop_back();
 }
 
-void CType::print() {
-    cout << COLOR_TYPE;
-    switch (storage) {
-        case CS::STATIC: cout << "static "; break;
-        case CS::EXTERN: cout << "extern "; break;
-    }
-    switch (modifier) {
-        case CS::UNSIGNED: cout << "unsigned "; break;
-    }
-    switch (type) {
-        case CS::STRUCT: cout << "struct" << name; break;
-        case CS::VOID: cout << "void"; break;
-        case CS::CHAR: cout << "char"; break;
-        case CS::INT: cout << "int"; break;
-        case CS::LONG: cout << "long"; break;
-        case CS::DOUBLE: cout << "double"; break;
+template <bool Color>
+void Printer<Color>::paint(std::string_view color, std::string_view text) {
+    if constexpr (Color) {
+        out << color << text << COLOR_RESET;
+    } else {
+        out << text;
     }
-    cout << COLOR_RESET;
 }
 
-// AST
-void Program::print(bool ending) {
-    indent_push();
-    cout << COLOR_CLASS << "Program" << COLOR_RESET << endl;
-    for (auto it = decls.begin(); it != decls.end(); ++it) {
-        (*it)->print(it + 1 == decls.end());
+template <bool Color>
+void Printer<Color>::print(const CType& type) {
+    std::string_view storage;
+    std::string_view modifier;
+    switch (type.storage) {
+        case CS::STATIC: storage = "static "; break;
+        case CS::EXTERN: storage = "extern "; break;
     }
-}
-
-
-// expression
-void Expression::print(bool ending) {
-    print_indent(ending);
-    if (left) {
-        cout << COLOR_OPERATOR << ((bool)mid ? "? :" : name) << COLOR_RESET << endl;
-        indent_push();
-        left->print(!(bool)right);
-        if (mid) {
-            mid->print(false);
-        }
-        if (right) {
-            right->print(true);
-        }
-        
-    } else {
-        // identifier
-        if (call.empty()) {
-            cout << name << endl;
-        } else {
-
-        }
+    switch (type.modifier) {
+        case CS::UNSIGNED: modifier = "unsigned "; break;
     }
-    cur -= (ending ? 2 : 0);
-}
-
-void Constant::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CONST << val << COLOR_RESET << endl;
-    cur -= (ending ? 2 : 0);
-}
-
-// statement
-void Statement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "EmptyStatement" << COLOR_RESET << endl;
-    cur -= (ending ? 2 : 0);
-}
-
-void ContinueStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "Continue" << COLOR_RESET << endl;
-    cur -= (ending ? 2 : 0);
-}
-
-void BreakStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "Break" << COLOR_RESET << endl;
-    cur -= (ending ? 2 : 0);
-}
-
-void ReturnStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "Return " << COLOR_RESET << endl;
-    indent_push();
-    exp->print(true);
-    cur -= (ending ? 2 : 0);
-}
-
-void IfStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "If" << COLOR_RESET << endl;
-    indent_push();
-    // condition
-    print_component("condition", false);
-    cond->print(true);
-    // then
-    print_component("then", !(bool)_else);
-    then->print(true);
-    // else
-    if (_else) {
-        print_component("else", true);
-        _else->print(true);
+    if constexpr (Color) {
+        out << COLOR_TYPE;
+    }
+    out << storage << modifier;
+    switch (type.type) {
+        case CS::STRUCT: out << "struct" << symbols->text(type.name); break;
+        case CS::VOID: out << "void"; break;
+        case CS::CHAR: out << "char"; break;
+        case CS::INT: out << "int"; break;
+        case CS::LONG: out << "long"; break;
+        case CS::DOUBLE: out << "double"; break;
+    }
+    if constexpr (Color) {
+        out << COLOR_RESET;
     }
-    cur -= (ending ? 4 : 2);
 }
 
-void WhileStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "While" << COLOR_RESET << endl;
-    indent_push();
-    // condition
-    print_component("condition", false);
-    cond->print(true);
-    // body
-    print_component("body", true);
-    body->print(true);
-    cur -= (ending ? 4 : 2);
+// AST
+template <bool Color>
+void Printer<Color>::print(const Program& program) {
+    begin(program.symbols);
+    for (auto it = program.decls.begin(); it != program.decls.end(); ++it) {
+        print(*it, it + 1 == program.decls.end());
+    }
 }
 
-void DoStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "Do" << COLOR_RESET << endl;
+template <bool Color>
+void Printer<Color>::begin(const Interner& names) {
+    symbols = &names;
     indent_push();
-    // body
-    print_component("body", false);
-    body->print(true);
-    // condition
-    print_component("condition", true);
-    cond->print(true);
-    cur -= (ending ? 4 : 2);
+    paint(COLOR_CLASS, "Program");
+    out << '\n';
 }
 
-void ForStatement::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "For" << COLOR_RESET << endl;
-    indent_push();
-    // init
-    if (init) {
-        print_component("initialization", false);
-        init->print(true);
-    }
-    // condition
-    if (cond) {
-        print_component("condition", false);
-        cond->print(true);
-    }
-    // increment
-    if (inc) {
-        print_component("increment", false);
-        inc->print(true);
+template <bool Color>
+void Printer<Color>::print(const AST* decl, bool last) {
+    tasks.push_back({Task::NODE, last, 0, decl, {}});
+    while (!tasks.empty()) {
+        Task t = tasks.back();
+        tasks.pop_back();
+        switch (t.kind) {
+            case Task::NODE:
+                visit(t.node, t.ending);
+                break;
+            case Task::COMPONENT:
+                // Print the name of component, then execute indent_push().
+                print_indent(t.ending);
+                paint(COLOR_COMPONENT, t.name);
+                out << '\n';
+                indent_push();
+                break;
+            case Task::DEDENT:
+                cur -= t.dedent;
+                break;
+        }
+        tasks.insert(tasks.end(), pending.rbegin(), pending.rend());
+        pending.clear();
     }
-    // body
-    print_component("body", true);
-    body->print(true);
-    cur -= (ending ? 4 : 2);
 }
 
-void Block::print(bool ending) {
+// Print the line of a node and schedule the rest.
+template <bool Color>
+void Printer<Color>::visit(const AST* n, bool ending) {
+    switch (n->kind) {
+        case NK::EXP_STATEMENT:
+            node(static_cast<const ExpStatement*>(n)->exp, ending);
+            return;
+        case NK::INITIALIZER: {
+            auto s = static_cast<const Initializer*>(n);
+            if (s->exp) {
+                node(s->exp, ending);
+            } else if (s->init_list.empty()) {
+                print_indent(ending);
+                paint(COLOR_COMPONENT, "initializer_list");
+                out << '\n';
+                dedent(ending ? 2 : 0);
+            } else {
+                component("initializer_list", ending);
+                for (auto it = s->init_list.begin(); it != s->init_list.end(); ++it) {
+                    node(*it, it + 1 == s->init_list.end());
+                }
+                dedent(ending ? 2 : 0);
+            }
+            return;
+        }
+        default:
+            break;
+    }
     print_indent(ending);
-    cout << COLOR_CLASS <<  "Block" << COLOR_RESET << endl;
-    indent_push();
-    for (auto it = items.begin(); it != items.end(); ++it) {
-        (*it)->print(it + 1 == items.end());
+    switch (n->kind) {
+        // expression
+        case NK::CONSTANT:
+            if constexpr (Color) {
+                out << COLOR_CONST;
+            }
+            out << static_cast<const Constant*>(n)->val;
+            if constexpr (Color) {
+                out << COLOR_RESET;
+            }
+            out << '\n';
+            break;
+        case NK::EXPRESSION: {
+            auto e = static_cast<const Expression*>(n);
+            if (e->left) {
+                paint(COLOR_OPERATOR, (bool)e->mid ? "? :" : op_name(e->op));
+                out << '\n';
+                indent_push();
+                node(e->left, !(bool)e->right);
+                if (e->mid) {
+                    node(e->mid, false);
+                }
+                if (e->right) {
+                    node(e->right, true);
+                }
+            } else {
+                // identifier
+                out << symbols->text(e->name);
+                if (!e->is_call) {
+                    out << '\n';
+                } else {
+                    // call, with the arguments below
+                    paint(COLOR_OPERATOR, "()");
+                    out << '\n';
+                    if (!e->call.empty()) {
+                        indent_push();
+                        for (auto it = e->call.begin(); it != e->call.end(); ++it) {
+                            node(*it, it + 1 == e->call.end());
+                        }
+                    }
+                }
+            }
+            break;
+        }
+        case NK::CHAIN: {
+            auto e = static_cast<const Chain*>(n);
+            paint(COLOR_OPERATOR, op_name(e->op));
+            out << '\n';
+            indent_push();
+            for (auto it = e->operands.begin(); it != e->operands.end(); ++it) {
+                node(*it, it + 1 == e->operands.end());
+            }
+            break;
+        }
+        // statement
+        case NK::EMPTY:
+            paint(COLOR_CLASS, "EmptyStatement");
+            out << '\n';
+            break;
+        case NK::CONTINUE:
+            paint(COLOR_CLASS, "Continue");
+            out << '\n';
+            break;
+        case NK::BREAK:
+            paint(COLOR_CLASS, "Break");
+            out << '\n';
+            break;
+        case NK::RETURN:
+            paint(COLOR_CLASS, "Return ");
+            out << '\n';
+            indent_push();
+            node(static_cast<const ReturnStatement*>(n)->exp, true);
+            break;
+        case NK::IF: {
+            auto s = static_cast<const IfStatement*>(n);
+            paint(COLOR_CLASS, "If");
+            out << '\n';
+            indent_push();
+            // condition
+            component("condition", false);
+            node(s->cond, true);
+            // then
+            component("then", !(bool)s->_else);
+            node(s->then, true);
+            // else
+            if (s->_else) {
+                component("else", true);
+                node(s->_else, true);
+            }
+            dedent(2);
+            break;
+        }
+        case NK::WHILE: {
+            auto s = static_cast<const WhileStatement*>(n);
+            paint(COLOR_CLASS, "While");
+            out << '\n';
+            indent_push();
+            // condition
+            component("condition", false);
+            node(s->cond, true);
+            // body
+            component("body", true);
+            node(s->body, true);
+            dedent(2);
+            break;
+        }
+        case NK::DO: {
+            auto s = static_cast<const DoStatement*>(n);
+            paint(COLOR_CLASS, "Do");
+            out << '\n';
+            indent_push();
+            // body
+            component("body", false);
+            node(s->body, true);
+            // condition
+            component("condition", true);
+            node(s->cond, true);
+            dedent(2);
+            break;
+        }
+        case NK::FOR: {
+            auto s = static_cast<const ForStatement*>(n);
+            paint(COLOR_CLASS, "For");
+            out << '\n';
+            indent_push();
+            // init
+            if (s->init) {
+                component("initialization", false);
+                node(s->init, true);
+            }
+            // condition
+            if (s->cond) {
+                component("condition", false);
+                node(s->cond, true);
+            }
+            // increment
+            if (s->inc) {
+                component("increment", false);
+                node(s->inc, true);
+            }
+            // body
+            component("body", true);
+            node(s->body, true);
+            dedent(2);
+            break;
+        }
+        case NK::BLOCK: {
+            auto s = static_cast<const Block*>(n);
+            paint(COLOR_CLASS, "Block");
+            out << '\n';
+            if (s->items.empty()) {
+                break;  // nothing to indent, which a last item would undo
+            }
+            indent_push();
+            for (auto it = s->items.begin(); it != s->items.end(); ++it) {
+                node(*it, it + 1 == s->items.end());
+            }
+            break;
+        }
+        // declaration
+        case NK::VARIABLE: {
+            auto s = static_cast<const Variable*>(n);
+            paint(COLOR_CLASS, "Varible");
+            out << '\n';
+            indent_push();
+            // type
+            print_indent(false);
+            paint(COLOR_COMPONENT, "type: ");
+            print(s->type);
+            out << '\n';
+            // declarator
+            print_indent(s->decl.indexes.empty() && !(bool)s->initializer);
+            paint(COLOR_COMPONENT, "declarator: ");
+            print(s->decl);
+            out << '\n';
+            // array size
+            if (!s->decl.indexes.empty()) {
+                component("array_size", !(bool)s->initializer);
+                for (auto it = s->decl.indexes.begin(); it != s->decl.indexes.end(); ++it) {
+                    node(*it, it + 1 == s->decl.indexes.end());
+                }
+            }
+            // initializer
+            if (s->initializer) {
+                component("initializer", true);
+                node(s->initializer, true);
+            }
+            dedent(2);
+            break;
+        }
+        case NK::FUNCTION: {
+            auto s = static_cast<const Function*>(n);
+            paint(COLOR_CLASS, "Function");
+            out << '\n';
+            indent_push();
+            // signature
+            print_indent(!(bool)s->body);
+            paint(COLOR_COMPONENT, "signature: ");
+            print(s->type);
+            out << " ";
+            print(s->decl);
+            out << '\n';
+            // body
+            if (s->body) {
+                component("body", true);
+                node(s->body, true);
+            }
+            dedent(2);
+            break;
+        }
+        default:
+            break;
     }
-    cur -= (ending ? 2 : 0);
-}
-
-void ExpStatement::print(bool ending) {
-    exp->print(ending);
+    dedent(ending ? 2 : 0);
 }
 
 // declaration
-void Declarator::print(bool ending) {
-    cout << string(depth, '*') << name;
-    if (!parameters.empty()) {
-        cout << "(";
-        for (auto it = parameters.begin(); it != parameters.end(); ++it) {
-            it->print(false);
-            if (it + 1 < parameters.end()) {
-                cout << ", ";
+template <bool Color>
+void Printer<Color>::print(const Declarator& decl) {
+    for (int i = 0; i < decl.depth; ++i) {
+        out << '*';
+    }
+    out << symbols->text(decl.name);
+    if (!decl.parameters.empty()) {
+        out << "(";
+        for (auto it = decl.parameters.begin(); it != decl.parameters.end(); ++it) {
+            print(*it);
+            if (it + 1 < decl.parameters.end()) {
+                out << ", ";
             }
         }
-        cout << ")";
+        out << ")";
     }
 }
 
-void Parameter::print(bool ending) {
-    type.print();
-    if (!decl.name.empty()) {
-        cout << " ";
-        decl.print(false);
+template <bool Color>
+void Printer<Color>::print(const Parameter& param) {
+    print(param.type);
+    if (param.decl.name != 0) {
+        out << " ";
+        print(param.decl);
     }
 }
 
-void Initializer::print(bool ending) {
-    if (init_list.empty()) {
-        exp->print(ending);
+template class Printer<true>;
+template class Printer<false>;
+
+void print_program(const Program& program, Output& out, bool color) {
+    if (color) {
+        out << COLOR_TITLE << "AST" << COLOR_RESET << '\n';
+        Printer<true>(out).print(program);
     } else {
-        print_component("initializer_list", true);
-        for (auto it = init_list.begin(); it != init_list.end(); ++it) {
-            (*it)->print(it + 1 == init_list.end());
-        }
-        cur -= 2;
+        out << "AST\n";
+        Printer<false>(out).print(program);
     }
 }
 
-void Variable::print(bool ending) {
-    print_indent(ending);    
-    cout << COLOR_CLASS << "Varible" << COLOR_RESET << endl;
-    indent_push();
-    // type
-    print_indent(false);
-    cout << COLOR_COMPONENT << "type: " << COLOR_RESET;
-    type.print();
-    cout << endl;
-    // declarator
-    print_indent(decl.indexes.empty() && !(bool)initializer);
-    cout << COLOR_COMPONENT << "declarator: " << COLOR_RESET;
-    decl.print(false);
-    cout << endl;
-    // array size
-    if (!decl.indexes.empty()) {
-        print_component("array_size", !(bool)initializer);
-        for (auto it = decl.indexes.begin(); it != decl.indexes.end(); ++it) {
-            (*it)->print(it + 1 == decl.indexes.end());
-        }
-    }
-    // initializer
-    if (initializer) {
-        print_component("initializer", true);
-        initializer->print(true);
-    }
-    cur -= (ending ? 4 : 2);
+DeclarationPrinter::DeclarationPrinter(Output& out, bool color, const Interner& names)
+    : printer(color ? decltype(printer)(std::in_place_index<0>, out) : decltype(printer)(std::in_place_index<1>, out)) {
+    out << (color ? COLOR_TITLE "AST" COLOR_RESET "\n" : "AST\n");
+    std::visit([&](auto& p) { p.begin(names); }, printer);
 }
 
-void Function::print(bool ending) {
-    print_indent(ending);
-    cout << COLOR_CLASS << "Function" << COLOR_RESET << endl;
-    indent_push();
-    // signature
-    print_indent(!(bool)body);
-    cout << COLOR_COMPONENT << "signature: " << COLOR_RESET;
-    type.print();
-    cout << " ";
-    decl.print(false);
-    cout << endl;
-    // body
-    print_component("body", true);
-    body->print(true);
-    cur -= (ending ? 4 : 2);
-}
\ No newline at end of file
+void DeclarationPrinter::print(const AST* decl, bool last) {
+    std::visit([&](auto& p) { p.print(decl, last); }, printer);
+}
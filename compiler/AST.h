@@ -1,14 +1,23 @@
+#ifndef HEADER_AST
+#define HEADER_AST
+
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <variant>
 
 #include "lexer.h"
+#include "intern.h"
+#include "arena.h"
+#include "output.h"
 
 using std::unique_ptr;
 using std::make_unique;
 
 // Note:
 // 1. Except for CType, Declarator, and Parameter, instances of all other types are stored as pointers.
+// 2. All nodes live in the Arena of their Program, which frees them at once without running destructors.
+//    Lists of children are arena Lists as well, so no node owns heap memory.
 
 // specifier
 enum struct CS{
@@ -33,176 +42,264 @@ struct CType {
     CType() = default;
     CType(CS t): type(t) {}
     CType(CS m, CS t) : modifier(m), type(t) {}
-    CType(CS t, string s) : type(t), name(s) {}
-    void print();
+    CType(CS t, Symbol s) : type(t), name(s) {}
     CS storage = CS::NONE;
     CS modifier = CS::NONE;
     CS type = CS::VOID;
-    string name = "";  // identifier of struct
+    Symbol name = 0;   // identifier of struct
+};
+
+// node kind, i.e., the concrete type of a node
+enum struct NK : uint8_t {
+    PROGRAM,
+    // expression
+    EXPRESSION,
+    CONSTANT,
+    CHAIN,
+    // statement
+    EMPTY,
+    CONTINUE,
+    BREAK,
+    RETURN,
+    IF,
+    WHILE,
+    DO,
+    FOR,
+    BLOCK,
+    EXP_STATEMENT,
+    // declaration
+    DECLARATOR,
+    PARAMETER,
+    INITIALIZER,
+    VARIABLE,
+    FUNCTION
 };
 
 // abstract syntax tree
+// Nodes have no virtual functions: code that needs the concrete type switches on "kind".
 struct AST {
 public:
-    virtual ~AST() = default;
-    virtual void print(bool ending) = 0;
-protected:
-    // The following members are all used for printing the AST.
-    static vector<int> indent;
-    static int cur;
-    void print_indent(bool ending);
-    void indent_push();
-    void print_component(string name, bool ending);
+    AST(NK k) : kind(k) {}
+    NK kind;
+};
+
+// Where a part of the source is, e.g., a function body that is only parsed on demand.
+struct SourceRange {
+    size_t offset = 0;
+    size_t length = 0;
+    int row = 0;
+    int col = 0;
 };
 
 struct Program : public AST {
-    void print(bool ending);
-    Program& operator+=(unique_ptr<AST> other) {
-        decls.push_back(std::move(other));
+    Program() : AST(NK::PROGRAM) {}
+    Program& operator+=(AST* other) {
+        decls.push_back(other);
         return *this;
     }
-    vector<unique_ptr<AST>> decls;
+    Arena arena;         // owns all the nodes below
+    vector<Arena> parts; // or these, if parts of the file were parsed separately
+    Interner symbols;    // names used by the nodes below
+    vector<AST*> decls;
+    vector<SourceRange> spans;  // of each declaration, from its first token up to the next declaration
+    // Of each declaration, the index of the part it is in, or IN_ARENA. Empty if they are all in "arena".
+    vector<uint32_t> owners;
+    static constexpr uint32_t IN_ARENA = UINT32_MAX;
 };
 
 
 // expression
 struct Expression : public AST {
-    Expression() = default;
-    Expression(string s) : name(s) {}
-    Expression(unique_ptr<Expression> l, string s) : name(s), left(std::move(l)) {}
-    void print(bool ending);
-    string name;
-    unique_ptr<Expression> left;
-    unique_ptr<Expression> mid;
-    unique_ptr<Expression> right;
-    vector<unique_ptr<Expression>> call;
+    Expression() : AST(NK::EXPRESSION) {}
+    Expression(Symbol s) : AST(NK::EXPRESSION), name(s) {}
+    Expression(OP o) : AST(NK::EXPRESSION), op(o) {}
+    Expression(Expression* l, OP o) : AST(NK::EXPRESSION), op(o), left(l) {}
+    OP op = OP::NONE;   // operator
+    Symbol name = 0;    // identifier
+    Expression* left = nullptr;
+    Expression* mid = nullptr;
+    Expression* right = nullptr;
+    List<Expression*> call;
+    bool is_call = false;  // "name(...)", with "call" the arguments, if any
+protected:
+    Expression(NK k) : AST(k) {}
 };
 
 struct Constant : public Expression {
-    Constant(int v) : val(v) {}
-    void print(bool ending);
+    Constant(int v) : Expression(NK::CONSTANT), val(v) {}
     int val;
 };
 
+// A run of one left-associative binary operator, "a + b + c", as one node with all the operands,
+// when the parser is asked for it (see TreeOptions). It means the same as the left-leaning binary nodes.
+struct Chain : public Expression {
+    Chain(OP o) : Expression(NK::CHAIN) { op = o; }
+    List<Expression*> operands;
+};
+
 // statement
 struct Statement : public AST {
     // empty statement
-    void print(bool ending);
+    Statement() : AST(NK::EMPTY) {}
+protected:
+    Statement(NK k) : AST(k) {}
 };
 
 struct ContinueStatement : public Statement {
-    void print(bool ending);
+    ContinueStatement() : Statement(NK::CONTINUE) {}
 };
 
 struct BreakStatement : public Statement {
-    void print(bool ending);
+    BreakStatement() : Statement(NK::BREAK) {}
 };
 
 struct ReturnStatement : public Statement {
-    ReturnStatement(unique_ptr<Expression> e) : exp(std::move(e)) {}
-    void print(bool ending);
-    unique_ptr<Expression> exp;
+    ReturnStatement(Expression* e) : Statement(NK::RETURN), exp(e) {}
+    Expression* exp = nullptr;
 };
 
 struct IfStatement : public Statement {
-    IfStatement(unique_ptr<Expression> c, unique_ptr<Statement> t) : cond(std::move(c)), then(std::move(t)) {}
-    void print(bool ending);
-    unique_ptr<Expression> cond;
-    unique_ptr<Statement> then;
-    unique_ptr<Statement> _else;
+    IfStatement(Expression* c, Statement* t) : Statement(NK::IF), cond(c), then(t) {}
+    Expression* cond = nullptr;
+    Statement* then = nullptr;
+    Statement* _else = nullptr;
 };
 
 struct WhileStatement : public Statement {
-    WhileStatement(unique_ptr<Expression> c, unique_ptr<Statement> s) : cond(std::move(c)), body(std::move(s)) {}
-    void print(bool ending);
-    unique_ptr<Expression> cond;
-    unique_ptr<Statement> body;
+    WhileStatement(Expression* c, Statement* s) : Statement(NK::WHILE), cond(c), body(s) {}
+    Expression* cond = nullptr;
+    Statement* body = nullptr;
 };
 
 struct DoStatement : public Statement {
-    DoStatement(unique_ptr<Statement> s, unique_ptr<Expression> c) : body(std::move(s)), cond(std::move(c)) {}
-    void print(bool ending);
-    unique_ptr<Statement> body;
-    unique_ptr<Expression> cond;
+    DoStatement(Statement* s, Expression* c) : Statement(NK::DO), body(s), cond(c) {}
+    Statement* body = nullptr;
+    Expression* cond = nullptr;
 };
 
 struct ForStatement : public Statement {
-    ForStatement() = default;
-    void print(bool ending);
-    unique_ptr<AST> init;
-    unique_ptr<Expression> cond;
-    unique_ptr<Expression> inc;
-    unique_ptr<Statement> body;
+    ForStatement() : Statement(NK::FOR) {}
+    AST* init = nullptr;
+    Expression* cond = nullptr;
+    Expression* inc = nullptr;
+    Statement* body = nullptr;
 };
 
 struct Block : public Statement {
-    Block() = default;
-    Block& operator+=(unique_ptr<AST> other) {
-        items.push_back(std::move(other));
-        return *this;
-    }
-    void print(bool ending);
-    vector<unique_ptr<AST>> items;
+    Block() : Statement(NK::BLOCK) {}
+    List<AST*> items;
 };
 
 struct ExpStatement : public Statement {
-    ExpStatement(unique_ptr<Expression> e) : exp(std::move(e)) {}
-    void print(bool ending);
-    unique_ptr<Expression> exp;
+    ExpStatement(Expression* e) : Statement(NK::EXP_STATEMENT), exp(e) {}
+    Expression* exp = nullptr;
 };
 
 
 // declaration
 struct Parameter;
 struct Declarator : public AST {
-    Declarator() = default;
-    Declarator(string s) : name(s) {}
-    void print(bool ending);
-    string name;
+    Declarator() : AST(NK::DECLARATOR) {}
+    Declarator(Symbol s) : AST(NK::DECLARATOR), name(s) {}
+    Symbol name = 0;
     int depth = 0;  // pointer depth
-    vector<Parameter> parameters;
-    vector<unique_ptr<Expression>> indexes;
+    List<Parameter> parameters;
+    List<Expression*> indexes;
 };
 
 struct Parameter : public AST {
-    Parameter() = default;
-    Parameter(CType t, Declarator d) : type(t), decl(std::move(d)) {}
-    void print(bool ending);
+    Parameter() : AST(NK::PARAMETER) {}
+    Parameter(CType t, Declarator d) : AST(NK::PARAMETER), type(t), decl(d) {}
     CType type;
     Declarator decl;
 };
 
 struct Initializer : public AST {
-    Initializer() = default;
-    Initializer(unique_ptr<Expression> p) { exp = std::move(p); }
-    Initializer& operator+=(unique_ptr<Initializer> other) {
-        init_list.push_back(std::move(other));
-        return *this;
-    }
-    void print(bool ending);
-    unique_ptr<Expression> exp;
-    vector<unique_ptr<Initializer>> init_list;
+    Initializer() : AST(NK::INITIALIZER) {}
+    Initializer(Expression* p) : AST(NK::INITIALIZER) { exp = p; }
+    Expression* exp = nullptr;
+    List<Initializer*> init_list;
 };
 
 struct Variable : public AST {
-    Variable(CType t, Declarator d) : type(t), decl(std::move(d)) {}
-    void init(unique_ptr<Initializer> p) { initializer = std::move(p); }
-    void print(bool ending);
+    Variable(CType t, Declarator d) : AST(NK::VARIABLE), type(t), decl(d) {}
+    void init(Initializer* p) { initializer = p; }
     CType type;
     Declarator decl;
-    unique_ptr<Initializer> initializer;
+    Initializer* initializer = nullptr;
 };
 
 struct Function : public AST {
-    Function(CType t, Declarator d) : type(t), decl(std::move(d)) {}
-    void print(bool ending);
+    Function(CType t, Declarator d) : AST(NK::FUNCTION), type(t), decl(d) {}
     CType type;
     Declarator decl;
-    unique_ptr<Block> body;
+    Block* body = nullptr;
+    SourceRange deferred;  // the body, from "{" to "}", if it was skipped (see Parser::defer_bodies)
 };
 
 // struct Struct : public AST {
 //     Struct(string s) : name(s) {}
 //     void print(bool ending);
 //     string name;
-// };
\ No newline at end of file
+// };
+
+// Prints the AST as a tree drawn with box-drawing characters.
+// With Color = false, no escape sequence is ever written, without any check at run time.
+// The tree is walked with an explicit stack of tasks, so its depth is only limited by memory.
+template <bool Color>
+class Printer {
+public:
+    Printer(Output& o) : out(o) {}
+    void print(const Program& program);
+    // Or a program piece by piece: its root, then each declaration, "last" for the final one.
+    void begin(const Interner& names);
+    void print(const AST* decl, bool last);
+private:
+    // One step of the walk: print a node, print the name of a component, or dedent.
+    struct Task {
+        enum Kind : uint8_t { NODE, COMPONENT, DEDENT } kind;
+        bool ending;
+        int dedent;
+        const AST* node;
+        std::string_view name;
+    };
+    Output& out;
+    const Interner* symbols = nullptr;
+    vector<Task> tasks;    // what is left to do, the next task at the back
+    vector<Task> pending;  // tasks scheduled by the current node, in order
+    // The following members are all used for printing the indentation.
+    vector<int> indent;    // columns of the connectors still open
+    vector<size_t> marks;  // length of "prefix" before each column was pushed
+    string prefix;         // what is printed before the connector of indent.back()
+    int cur = 0;
+    void print_indent(bool ending);
+    void indent_push();
+    void indent_pop();
+    void paint(std::string_view color, std::string_view text);
+    void node(const AST* node, bool ending) { pending.push_back({Task::NODE, ending, 0, node, {}}); }
+    void component(std::string_view name, bool ending) { pending.push_back({Task::COMPONENT, ending, 0, nullptr, name}); }
+    void dedent(int n) {
+        if (n != 0) {
+            pending.push_back({Task::DEDENT, false, n, nullptr, {}});
+        }
+    }
+    void visit(const AST* node, bool ending);
+    void print(const CType& type);
+    void print(const Declarator& decl);
+    void print(const Parameter& param);
+};
+
+// Print "AST" and the tree, choosing the printer once.
+void print_program(const Program& program, Output& out, bool color);
+
+// Likewise, but one declaration at a time as they come, e.g., straight from the parser,
+// so nothing has to be kept once printed. The output is the same as that of print_program().
+class DeclarationPrinter {
+public:
+    DeclarationPrinter(Output& out, bool color, const Interner& names);
+    void print(const AST* decl, bool last);
+private:
+    std::variant<Printer<true>, Printer<false>> printer;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef HEADER_ARENA
+#define HEADER_ARENA
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+// Fixed-size array living in an Arena.
+template <class T>
+struct List {
+    T* data = nullptr;
+    size_t count = 0;
+    T* begin() const { return data; }
+    T* end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) const { return data[i]; }
+    T& back() const { return data[count - 1]; }
+};
+
+// Bump-pointer allocator.
+// Objects are placed one after another in allocation order and are never destroyed one by one:
+// everything is released at once with the arena, so only trivial cleanup may be relied on.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept { swap(other); }
+    Arena& operator=(Arena&& other) noexcept { Arena tmp(std::move(other)); swap(tmp); return *this; }
+    ~Arena() { release(); }
+
+    void* allocate(size_t size, size_t align) {
+        size_t pad = -reinterpret_cast<uintptr_t>(cur) & (align - 1);
+        if (pad + size > static_cast<size_t>(limit - cur)) {
+            grow(size + align);
+            pad = -reinterpret_cast<uintptr_t>(cur) & (align - 1);
+        }
+        char* ret = cur + pad;
+        cur = ret + size;
+        bytes += pad + size;
+        return ret;
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copy [first, last) into the arena.
+    template <class T, class It>
+    List<T> list(It first, It last) {
+        List<T> ret;
+        ret.count = static_cast<size_t>(last - first);
+        if (ret.count != 0) {
+            ret.data = static_cast<T*>(allocate(sizeof(T) * ret.count, alignof(T)));
+            for (size_t i = 0; i != ret.count; ++i) {
+                new (ret.data + i) T(static_cast<T>(first[i]));
+            }
+        }
+        return ret;
+    }
+
+    size_t used() const { return bytes; }          // bytes handed out, padding included
+    size_t reserved() const { return capacity; }   // bytes taken from the heap
+
+private:
+    // Blocks are chained through a header, so freeing walks them once with no bookkeeping.
+    struct Block {
+        Block* prev;
+        size_t size;
+    };
+
+public:
+    // Where the arena is at, to free what is allocated after it with rewind().
+    struct Mark {
+        Block* head;
+        char* cur;
+        size_t bytes;
+    };
+    Mark mark() const { return {head, cur, bytes}; }
+    // Free everything allocated since "m" at once, e.g., a declaration that was only printed.
+    // Of the blocks taken since, the first is kept for what comes next, so rewinding in a loop
+    // does not go back to the heap each time.
+    void rewind(const Mark& m) {
+        while (head != m.head && head->prev != m.head) {
+            Block* prev = head->prev;
+            capacity -= head->size;
+            std::free(head);
+            head = prev;
+        }
+        cur = head == m.head ? m.cur : reinterpret_cast<char*>(head + 1);
+        limit = head ? reinterpret_cast<char*>(head) + head->size : nullptr;
+        bytes = m.bytes;
+    }
+
+private:
+    static constexpr size_t MIN_BLOCK = 64 << 10;
+    static constexpr size_t MAX_BLOCK = 4 << 20;
+    Block* head = nullptr;
+    char* cur = nullptr;
+    char* limit = nullptr;
+    size_t bytes = 0;
+    size_t capacity = 0;
+    size_t next_block = MIN_BLOCK;
+
+    void grow(size_t need) {
+        size_t size = std::max(next_block, need + sizeof(Block));
+        next_block = std::min(next_block * 2, MAX_BLOCK);
+        Block* b = static_cast<Block*>(std::malloc(size));
+        if (!b) {
+            throw std::bad_alloc();
+        }
+        b->prev = head;
+        b->size = size;
+        head = b;
+        cur = reinterpret_cast<char*>(b + 1);
+        limit = reinterpret_cast<char*>(b) + size;
+        capacity += size;
+    }
+
+    void release() {
+        while (head) {
+            Block* prev = head->prev;
+            std::free(head);
+            head = prev;
+        }
+    }
+
+    void swap(Arena& other) noexcept {
+        std::swap(head, other.head);
+        std::swap(cur, other.cur);
+        std::swap(limit, other.limit);
+        std::swap(bytes, other.bytes);
+        std::swap(capacity, other.capacity);
+        std::swap(next_block, other.next_block);
+    }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include <cstring>
+
+#include "error.h"
+#include "astfile.h"
+
+static uint64_t padded(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+void write_ast(const Program& program, Output& out) {
+    FlatAST flat = flatten(program);
+    vector<uint32_t> offsets = {0};
+    string names;
+    for (Symbol s = 0; s < program.symbols.size(); ++s) {
+        names += program.symbols.text(s);
+        offsets.push_back(static_cast<uint32_t>(names.size()));
+    }
+
+    std::string_view arrays[AstHeader::ARRAYS];
+    auto bytes = [](const auto& v) {
+        return std::string_view(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(v[0]));
+    };
+    AstHeader h{};
+    memcpy(h.magic, AstHeader::MAGIC, sizeof(h.magic));
+    h.version = AstHeader::VERSION;
+    h.order = AstHeader::ORDER;
+    h.root = flat.root;
+    arrays[AstHeader::NODES] = bytes(flat.nodes);
+    h.counts[AstHeader::NODES] = flat.nodes.size();
+    arrays[AstHeader::EXTRA] = bytes(flat.extra);
+    h.counts[AstHeader::EXTRA] = flat.extra.size();
+    arrays[AstHeader::TYPES] = bytes(flat.types);
+    h.counts[AstHeader::TYPES] = flat.types.size();
+    arrays[AstHeader::DECLARATORS] = bytes(flat.declarators);
+    h.counts[AstHeader::DECLARATORS] = flat.declarators.size();
+    arrays[AstHeader::PARAMETERS] = bytes(flat.parameters);
+    h.counts[AstHeader::PARAMETERS] = flat.parameters.size();
+    arrays[AstHeader::SPANS] = bytes(program.spans);
+    h.counts[AstHeader::SPANS] = program.spans.size();
+    arrays[AstHeader::SYMBOL_OFFSETS] = bytes(offsets);
+    h.counts[AstHeader::SYMBOL_OFFSETS] = offsets.size();
+    arrays[AstHeader::SYMBOL_BYTES] = names;
+    h.counts[AstHeader::SYMBOL_BYTES] = names.size();
+    uint64_t size = sizeof(h);
+    for (int a = 0; a != AstHeader::ARRAYS; ++a) {
+        h.offsets[a] = size;
+        size += padded(arrays[a].size());
+    }
+    h.size = size;
+
+    static constexpr char zeros[8] = {};
+    out << std::string_view(reinterpret_cast<const char*>(&h), sizeof(h));
+    for (std::string_view a : arrays) {
+        out << a << std::string_view(zeros, padded(a.size()) - a.size());
+    }
+}
+
+AstView::AstView(std::string_view bytes) : base(bytes.data()) {
+    if (bytes.size() < sizeof(header)) {
+        file_error("not a binary AST: too short");
+    }
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, AstHeader::MAGIC, sizeof(header.magic)) != 0) {
+        file_error("not a binary AST");
+    }
+    if (header.order != AstHeader::ORDER) {
+        file_error("the binary AST was written on a machine of another byte order");
+    }
+    if (header.version != AstHeader::VERSION) {
+        file_error(std::format("the binary AST is of version {}, but only {} is supported",
+                               header.version, AstHeader::VERSION));
+    }
+    if (header.size > bytes.size()) {
+        file_error("the binary AST is truncated");
+    }
+    static constexpr size_t sizes[AstHeader::ARRAYS] = {
+        sizeof(FlatNode), sizeof(uint32_t), sizeof(FlatType), sizeof(FlatDeclarator),
+        sizeof(FlatParameter), sizeof(SourceRange), sizeof(uint32_t), 1
+    };
+    for (int a = 0; a != AstHeader::ARRAYS; ++a) {
+        uint64_t offset = header.offsets[a];
+        if (offset % 8 != 0 || offset < sizeof(header) || offset > header.size
+            || header.counts[a] > (header.size - offset) / sizes[a]) {
+            file_error("the binary AST is damaged");
+        }
+    }
+    std::span<const uint32_t> offsets = array<uint32_t>(AstHeader::SYMBOL_OFFSETS);
+    if (offsets.empty() || offsets.back() > header.counts[AstHeader::SYMBOL_BYTES]
+        || (header.root != NO_NODE && header.root >= header.counts[AstHeader::NODES])) {
+        file_error("the binary AST is damaged");
+    }
+    if (reinterpret_cast<uintptr_t>(base) % 8 != 0) {
+        file_error("the binary AST is not aligned in memory");
+    }
+}
+
+FlatView AstView::flat() const {
+    return {array<FlatNode>(AstHeader::NODES), array<uint32_t>(AstHeader::EXTRA),
+            array<FlatType>(AstHeader::TYPES), array<FlatDeclarator>(AstHeader::DECLARATORS),
+            array<FlatParameter>(AstHeader::PARAMETERS), header.root};
+}
+
+unique_ptr<Program> read_ast(const AstView& image) {
+    auto ret = make_unique<Program>();
+    for (Symbol s = 1; s < image.symbol_count(); ++s) {
+        ret->symbols.intern(image.symbol(s));
+    }
+    unflatten(image.flat(), *ret);
+    std::span<const SourceRange> spans = image.spans();
+    ret->spans.assign(spans.begin(), spans.end());
+    return ret;
+}
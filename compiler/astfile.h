@@ -0,0 +1,92 @@
+#ifndef HEADER_ASTFILE
+#define HEADER_ASTFILE
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "flat.h"
+#include "source.h"
+
+// Binary AST format, for tools that want the tree of a file without parsing gardenia's text dump.
+// An image is a header followed by the arrays below, each starting at a multiple of 8 bytes from
+// the start, so a reader maps the file and uses the arrays in place; opening it costs the same
+// whatever its size. Nodes, types, declarators, and parameters are laid out as in flat.h, and
+// numbers are in the byte order of the writer, which the header records.
+//
+// Symbols are stored as SYMBOL_OFFSETS (one more than there are symbols) into SYMBOL_BYTES:
+// the text of Symbol s is [offsets[s], offsets[s + 1]), and Symbol 0 is the empty name.
+// SPANS are the ranges of the declarations in the source, empty if they are not known.
+//
+// A reader accepts only its own VERSION. Node indices are taken as they are, so an image should
+// come from gardenia itself: only the header and the bounds of the arrays are checked.
+struct AstHeader {
+    static constexpr char MAGIC[8] = {'G', 'D', 'N', 'A', 'S', 'T', '\0', '\0'};
+    static constexpr uint32_t VERSION = 2;   // bump whenever the layout changes
+    static constexpr uint32_t ORDER = 0x01020304;
+
+    enum Array {
+        NODES,
+        EXTRA,
+        TYPES,
+        DECLARATORS,
+        PARAMETERS,
+        SPANS,
+        SYMBOL_OFFSETS,
+        SYMBOL_BYTES,
+        ARRAYS
+    };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t order;     // ORDER as written
+    uint64_t size;      // of the whole image
+    uint32_t root;      // of the flat AST
+    uint32_t reserved;
+    uint64_t offsets[ARRAYS];  // where each array starts, from the start of the image
+    uint64_t counts[ARRAYS];   // number of items in each
+};
+
+static_assert(sizeof(FlatNode) == 16 && sizeof(FlatType) == 16 && sizeof(FlatDeclarator) == 24
+              && sizeof(FlatParameter) == 8 && sizeof(SourceRange) == 24, "the binary AST layout changed");
+
+// Append the image of "program" to "out".
+void write_ast(const Program& program, Output& out);
+
+// An image in memory, used in place: opening it only checks the header.
+class AstView {
+public:
+    // Throws a CompileError if "bytes" does not start with a whole image of this version.
+    explicit AstView(std::string_view bytes);
+    FlatView flat() const;
+    std::span<const SourceRange> spans() const { return array<SourceRange>(AstHeader::SPANS); }
+    size_t symbol_count() const { return header.counts[AstHeader::SYMBOL_OFFSETS] - 1; }
+    std::string_view symbol(Symbol s) const {
+        std::span<const uint32_t> offsets = array<uint32_t>(AstHeader::SYMBOL_OFFSETS);
+        return {base + header.offsets[AstHeader::SYMBOL_BYTES] + offsets[s], offsets[s + 1] - offsets[s]};
+    }
+    size_t size() const { return header.size; }
+private:
+    const char* base;
+    AstHeader header;
+    template <class T>
+    std::span<const T> array(AstHeader::Array a) const {
+        return {reinterpret_cast<const T*>(base + header.offsets[a]), header.counts[a]};
+    }
+};
+
+// A binary AST file, mapped into memory.
+class AstFile {
+public:
+    explicit AstFile(const string& path) : source(path), image(source.view()) {}
+    const AstView& view() const { return image; }
+    const AstView* operator->() const { return &image; }
+private:
+    Source source;
+    AstView image;
+};
+
+// The pointer tree of an image, e.g., to print it.
+unique_ptr<Program> read_ast(const AstView& image);
+
+#endif
@@ -0,0 +1,360 @@
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "astfile.h"
+#include "source.h"
+#include "cache.h"
+
+#ifndef GARDENIA_VERSION
+#define GARDENIA_VERSION "unknown"
+#endif
+
+static constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t lane(uint64_t acc, uint64_t input) {
+    return std::rotl(acc + input * P2, 31) * P1;
+}
+
+static uint64_t merge(uint64_t acc, uint64_t v) {
+    return (acc ^ lane(0, v)) * P1 + P4;
+}
+
+static uint64_t read64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t hash_bytes(std::string_view s, uint64_t seed) {
+    const char* p = s.data();
+    const char* end = p + s.size();
+    uint64_t h;
+    if (s.size() >= 32) {
+        uint64_t v1 = seed + P1 + P2;
+        uint64_t v2 = seed + P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - P1;
+        for (; end - p >= 32; p += 32) {
+            v1 = lane(v1, read64(p));
+            v2 = lane(v2, read64(p + 8));
+            v3 = lane(v3, read64(p + 16));
+            v4 = lane(v4, read64(p + 24));
+        }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    } else {
+        h = seed + P5;
+    }
+    h += s.size();
+    for (; end - p >= 8; p += 8) {
+        h = std::rotl(h ^ lane(0, read64(p)), 27) * P1 + P4;
+    }
+    if (end - p >= 4) {
+        uint32_t k;
+        memcpy(&k, p, sizeof(k));
+        h = std::rotl(h ^ (k * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p != end; ++p) {
+        h = std::rotl(h ^ (static_cast<uint8_t>(*p) * P5), 11) * P1;
+    }
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Layout of an entry: the header, the tokens and their values, each padded to 8 bytes, and then
+// the program as a binary AST image (see astfile.h).
+// Entries are only read by the machine that wrote them, so numbers are stored as they are in memory.
+static constexpr char MAGIC[8] = {'G', 'D', 'N', 'C', 'A', 'C', 'H', 'E'};
+static constexpr uint32_t FORMAT = 4;  // bump whenever the layout changes
+
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t version;      // hash of the gardenia version
+    uint64_t source;       // hash of the source
+    uint64_t size;         // of the source
+    uint64_t checksum;     // hash of everything after the header
+    uint64_t tokens;
+    uint64_t token_bytes;  // the tokens, encoded by put_token()
+    uint64_t value_bytes;  // the values of the tokens that are not in the source, one after another
+};
+
+static uint64_t version_hash() {
+    static const uint64_t ret = hash_bytes(GARDENIA_VERSION, FORMAT);
+    return ret;
+}
+
+static void put_number(string& out, uint64_t v) {
+    for (; v >= 0x80; v >>= 7) {
+        out += static_cast<char>(v | 0x80);
+    }
+    out += static_cast<char>(v);
+}
+
+static bool get_number(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p != end && shift < 64; shift += 7) {
+        uint8_t b = static_cast<uint8_t>(*p++);
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (b < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A token takes a few bytes: its type and operator, then the numbers of its position relative to
+// the token before, and of its value. Unless it was decoded, the value is a view of the source,
+// at the token or right after its quote, so only its length is kept.
+static void put_token(string& out, string& values, const Token& t, const Token& before, std::string_view text) {
+    out += static_cast<char>(t.type);
+    out += static_cast<char>(t.op);
+    put_number(out, t.offset - before.offset);
+    put_number(out, t.row - before.row);
+    put_number(out, t.col);
+    uint64_t at = reinterpret_cast<uintptr_t>(t.value.data()) - reinterpret_cast<uintptr_t>(text.data() + t.offset);
+    if (at > 1) {
+        at = 2;
+        values += t.value;
+    }
+    put_number(out, t.value.size() << 2 | at);
+}
+
+static uint64_t padded(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+template <class T>
+static void put(string& out, const T* p, size_t n) {
+    out.append(reinterpret_cast<const char*>(p), n * sizeof(T));
+    out.resize(padded(out.size()));
+}
+
+// Takes the parts of an entry in order, checking that they are inside it.
+class Reader {
+public:
+    Reader(std::string_view s) : p(s.data()), end(s.data() + s.size()) {}
+    const char* take(uint64_t n, size_t size) {
+        if (n > static_cast<uint64_t>(end - p) / size) {
+            return nullptr;
+        }
+        const char* ret = p;
+        p += std::min<size_t>(padded(n * size), end - p);
+        return ret;
+    }
+    std::string_view rest() const { return {p, static_cast<size_t>(end - p)}; }
+private:
+    const char* p;
+    const char* end;
+};
+
+Cache::Cache(string d, size_t c) : dir(std::move(d)), capacity(c) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    usable = std::filesystem::is_directory(dir, ec);
+}
+
+string Cache::path(std::string_view text) const {
+    return std::format("{}/{:016x}.gc", dir, hash_bytes(text, version_hash()));
+}
+
+std::optional<CacheEntry> Cache::load(std::string_view text, bool with_tokens) const {
+    if (!usable) {
+        return std::nullopt;
+    }
+    string file = path(text);
+    if (access(file.c_str(), R_OK) != 0) {
+        return std::nullopt;
+    }
+    CacheEntry ret;
+    try {
+        ret.storage = make_unique<Source>(file);
+    } catch (const CompileError&) {
+        return std::nullopt;  // removed since
+    }
+    if (ret.storage->length() < sizeof(Header)) {
+        return std::nullopt;
+    }
+
+    Header h;
+    memcpy(&h, ret.storage->begin(), sizeof(h));
+    std::string_view body = ret.storage->view().substr(sizeof(h));
+    if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.format != FORMAT || h.version != version_hash()
+        || h.size != text.size() || h.source != hash_bytes(text) || h.checksum != hash_bytes(body)) {
+        return std::nullopt;
+    }
+    Reader r(body);
+    const char* tokens = r.take(h.token_bytes, 1);
+    const char* values = r.take(h.value_bytes, 1);
+    if (!tokens || !values) {
+        return std::nullopt;
+    }
+    std::optional<AstView> image;
+    try {
+        image.emplace(r.rest());
+    } catch (const CompileError&) {
+        return std::nullopt;
+    }
+
+    const char* tokens_end = tokens + h.token_bytes;
+    const char* values_end = values + h.value_bytes;
+    Token t{TT::END, {}, 0, 0};
+    if (with_tokens) {
+        ret.tokens.reserve(h.tokens);
+    }
+    for (uint64_t i = 0; with_tokens && i != h.tokens; ++i) {
+        uint64_t offset, rows, col, length;
+        if (tokens_end - tokens < 2) {
+            return std::nullopt;
+        }
+        t.type = static_cast<TT>(static_cast<uint8_t>(*tokens++));
+        t.op = static_cast<OP>(*tokens++);
+        if (!get_number(tokens, tokens_end, offset) || !get_number(tokens, tokens_end, rows)
+            || !get_number(tokens, tokens_end, col) || !get_number(tokens, tokens_end, length)) {
+            return std::nullopt;
+        }
+        t.offset += offset;
+        t.row += static_cast<int>(rows);
+        t.col = static_cast<int>(col);
+        uint64_t at = length & 3;
+        length >>= 2;
+        const char* from = at < 2 ? text.data() + t.offset + at : values;
+        const char* limit = at < 2 ? text.data() + text.size() : values_end;
+        if (at > 2 || t.offset >= text.size() || length > static_cast<uint64_t>(limit - from)) {
+            return std::nullopt;
+        }
+        t.value = std::string_view(from, length);
+        if (at == 2) {
+            values += length;
+        }
+        ret.tokens.push_back(t);
+    }
+
+    ret.program = read_ast(*image);
+    utimensat(AT_FDCWD, file.c_str(), nullptr, 0);  // recently used
+    return ret;
+}
+
+void Cache::store(std::string_view text, const Program& program) const {
+    if (!usable) {
+        return;
+    }
+    uint64_t count = 0;
+    string tokens;
+    string values;
+    try {
+        Lexer lexer(text.data(), text.size(), false);
+        Token before{TT::END, {}, 0, 0};
+        for (Token t = lexer.next(); t.type != TT::END; t = lexer.next()) {
+            put_token(tokens, values, t, before, text);
+            before = t;
+            ++count;
+        }
+    } catch (const CompileError&) {
+        return;
+    }
+    Header h{};
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.format = FORMAT;
+    h.version = version_hash();
+    h.source = hash_bytes(text);
+    h.size = text.size();
+    h.tokens = count;
+    h.token_bytes = tokens.size();
+    h.value_bytes = values.size();
+    string out(sizeof(h), '\0');
+    put(out, tokens.data(), tokens.size());
+    put(out, values.data(), values.size());
+    {
+        Output image(out);
+        write_ast(program, image);
+    }
+    h.checksum = hash_bytes(std::string_view(out).substr(sizeof(h)));
+    memcpy(out.data(), &h, sizeof(h));
+
+    // Written aside and renamed into place, so no reader sees a part of it.
+    static std::atomic<unsigned> written = 0;
+    string file = path(text);
+    string temp = std::format("{}.tmp.{}.{}", file, getpid(), written++);
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    bool ok = true;
+    for (size_t done = 0; done != out.size(); ) {
+        ssize_t n = write(fd, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+        done += n;
+    }
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp.c_str(), file.c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    evict();
+}
+
+// Remove the least recently used entries until the rest fit in the capacity.
+// Other processes may be doing the same, so entries that are already gone are skipped.
+void Cache::evict() const {
+    namespace fs = std::filesystem;
+    struct Item {
+        fs::path path;
+        fs::file_time_type time;
+        uintmax_t size;
+    };
+    vector<Item> items;
+    uintmax_t total = 0;
+    std::error_code ec;
+    auto stale = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::error_code e;
+        Item item{entry.path(), entry.last_write_time(e), entry.file_size(e)};
+        if (e) {
+            continue;
+        }
+        if (item.path.filename().string().find(".tmp.") != string::npos) {
+            if (item.time < stale) {
+                fs::remove(item.path, e);  // left by a process that died while writing it
+            }
+        } else if (item.path.extension() == ".gc") {
+            total += item.size;
+            items.push_back(std::move(item));
+        }
+    }
+    if (total <= capacity) {
+        return;
+    }
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.time < b.time; });
+    for (const Item& item : items) {
+        if (total <= capacity) {
+            break;
+        }
+        if (fs::remove(item.path, ec)) {
+            total -= item.size;
+        }
+    }
+}
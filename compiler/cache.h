@@ -0,0 +1,39 @@
+#ifndef HEADER_CACHE
+#define HEADER_CACHE
+
+#include <optional>
+
+#include "lexer.h"
+#include "source.h"
+#include "AST.h"
+
+// A fast 64-bit hash of some bytes (the rounds of xxHash64), not meant to resist attacks.
+uint64_t hash_bytes(std::string_view s, uint64_t seed = 0);
+
+// The result of parsing a file, as loaded from a cache.
+struct CacheEntry {
+    unique_ptr<Source> storage;   // the entry, mapped; the values of some tokens point into it
+    vector<Token> tokens;         // values point into the source otherwise
+    unique_ptr<Program> program;
+};
+
+// Parse results kept in a directory across runs, keyed by a hash of the source and the gardenia version.
+// Each entry is one file, written to a temporary name and then renamed, so processes may share a directory:
+// a reader sees a whole entry or none. A hit touches the file, and entries whose modification time
+// is the oldest are removed once the directory holds more than "capacity" bytes.
+class Cache {
+public:
+    Cache(string d, size_t capacity);
+    // The program of "text", and its tokens "with_tokens", if stored before.
+    std::optional<CacheEntry> load(std::string_view text, bool with_tokens) const;
+    // Store the program parsed from "text", with the tokens lexed again.
+    void store(std::string_view text, const Program& program) const;
+private:
+    string dir;
+    size_t capacity;
+    bool usable;   // whether the directory exists or could be made
+    string path(std::string_view text) const;
+    void evict() const;
+};
+
+#endif
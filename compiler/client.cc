@@ -0,0 +1,173 @@
+// A client of "gardenia --serve", for testing it and for measuring what it saves.
+//
+//   gardenia-client SOCKET WORDS...
+//       send one request (see serve.h), with stdin as the source if the path is "-",
+//       and print the response as the command line would
+//   gardenia-client --bench N SOCKET FILE [GARDENIA]
+//       time N requests "print --no-color FILE" against N runs of "GARDENIA --no-color FILE",
+//       where GARDENIA defaults to the gardenia next to this client
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "serve.h"
+
+extern char** environ;
+
+using Clock = std::chrono::steady_clock;
+
+static int request(const string& socket, const vector<string>& words) {
+    int fd = connect_to(socket);
+    if (fd < 0) {
+        cerr << COLOR_ERROR << "error: " << COLOR_RESET << "cannot connect to " << socket << endl;
+        return 1;
+    }
+    string message;
+    for (const string& w : words) {
+        message += message.empty() ? "" : " ";
+        message += w;
+    }
+    if (words.back() == "-") {
+        message += '\n';
+        message.append(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+    string response;
+    if (!write_frame(fd, message) || read_frame(fd, response) != FrameRead::OK) {
+        cerr << COLOR_ERROR << "error: " << COLOR_RESET << "the server closed the connection" << endl;
+        return 1;
+    }
+    close(fd);
+    size_t newline = std::min(response.find('\n'), response.size());
+    std::string_view status(response.data(), newline);
+    std::string_view body = std::string_view(response).substr(std::min(newline + 1, response.size()));
+    if (status == "ok") {
+        cout << body;
+        return 0;
+    }
+    if (status.starts_with("error ")) {
+        size_t n = std::min<size_t>(std::stoul(string(status.substr(6))), body.size());
+        cout << body.substr(0, n) << std::flush;
+        cerr << body.substr(n);
+        return 1;
+    }
+    cerr << COLOR_ERROR << status << ": " << COLOR_RESET << body;
+    return 2;
+}
+
+struct Latency {
+    double mean, p50, p99;  // in microseconds
+};
+
+static Latency summarize(vector<double>& times) {
+    std::sort(times.begin(), times.end());
+    double sum = 0;
+    for (double t : times) {
+        sum += t;
+    }
+    return {sum / times.size(), times[times.size() / 2], times[std::min(times.size() - 1, times.size() * 99 / 100)]};
+}
+
+template <class F>
+static vector<double> time_each(int n, F run) {
+    vector<double> times;
+    for (int i = 0; i != n; ++i) {
+        auto start = Clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    return times;
+}
+
+static int bench(int n, const string& socket, const string& file, const string& gardenia) {
+    int fd = connect_to(socket);
+    if (fd < 0) {
+        cerr << COLOR_ERROR << "error: " << COLOR_RESET << "cannot connect to " << socket << endl;
+        return 1;
+    }
+    string message = "print --no-color " + file;
+    string response;
+    size_t server_bytes = 0;
+    auto ask = [&] {
+        if (!write_frame(fd, message) || read_frame(fd, response) != FrameRead::OK) {
+            cerr << COLOR_ERROR << "error: " << COLOR_RESET << "the server closed the connection" << endl;
+            exit(1);
+        }
+    };
+    ask();  // the first request warms the server up, as its first client would
+    if (!response.starts_with("ok\n")) {
+        cerr << COLOR_ERROR << "error: " << COLOR_RESET << "the server cannot print " << file << endl;
+        return 1;
+    }
+    server_bytes = response.size() - 3;
+    vector<double> server = time_each(n, ask);
+    close(fd);
+
+    size_t process_bytes = 0;
+    auto run = [&] {
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0) {
+            exit(1);
+        }
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, pipe_fds[0]);
+        string no_color = "--no-color";
+        char* argv[] = {const_cast<char*>(gardenia.c_str()), no_color.data(), const_cast<char*>(file.c_str()), nullptr};
+        pid_t pid;
+        int failed = posix_spawn(&pid, gardenia.c_str(), &actions, nullptr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipe_fds[1]);
+        if (failed) {
+            cerr << COLOR_ERROR << "error: " << COLOR_RESET << "cannot run " << gardenia << endl;
+            exit(1);
+        }
+        char buf[1 << 16];
+        process_bytes = 0;
+        for (ssize_t got; (got = read(pipe_fds[0], buf, sizeof(buf))) > 0; ) {
+            process_bytes += got;
+        }
+        close(pipe_fds[0]);
+        int status;
+        waitpid(pid, &status, 0);
+    };
+    vector<double> process = time_each(n, run);
+    if (process_bytes != server_bytes) {
+        cerr << COLOR_ERROR << "warning: " << COLOR_RESET << "the server printed " << server_bytes
+             << " bytes, but " << gardenia << ' ' << process_bytes << endl;
+    }
+
+    Latency s = summarize(server), p = summarize(process);
+    cout << std::format("{} requests for {} ({} bytes of output)\n", n, file, server_bytes);
+    cout << std::format("{:<12}{:>12}{:>12}{:>12}\n", "latency/us", "mean", "p50", "p99");
+    cout << std::format("{:<12}{:>12.1f}{:>12.1f}{:>12.1f}\n", "server", s.mean, s.p50, s.p99);
+    cout << std::format("{:<12}{:>12.1f}{:>12.1f}{:>12.1f}\n", "fork/exec", p.mean, p.p50, p.p99);
+    cout << std::format("the server is {:.1f}x as fast on average\n", p.mean / s.mean);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    if (!args.empty() && args[0] == "--bench") {
+        if (args.size() < 4 || args.size() > 5 || std::atoi(args[1].c_str()) <= 0) {
+            cerr << "usage: gardenia-client --bench N SOCKET FILE [GARDENIA]" << endl;
+            return 2;
+        }
+        string gardenia = args.size() == 5
+            ? args[4]
+            : (std::filesystem::read_symlink("/proc/self/exe").parent_path() / "gardenia").string();
+        return bench(std::atoi(args[1].c_str()), args[2], args[3], gardenia);
+    }
+    if (args.size() < 2) {
+        cerr << "usage: gardenia-client SOCKET WORDS...\n"
+                "       gardenia-client --bench N SOCKET FILE [GARDENIA]" << endl;
+        return 2;
+    }
+    return request(args[0], vector<string>(args.begin() + 1, args.end()));
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+
+#include "parser.h"
+#include "astfile.h"
+#include "json.h"
+#include "parallel.h"
+#include "driver.h"
+
+bool set_option(const vector<string>& args, size_t& i, Options& options, string& error) {
+    const string& arg = args[i];
+    if (arg == "--lex") {         // print tokens
+        options.lex = true;
+    } else if (arg == "--no-color") {  // plain output without escape sequences
+        options.color = false;
+    } else if (arg == "--pipeline") {  // lex ahead of the parser on another thread
+        options.pipeline = true;
+    } else if (arg == "--parallel") {  // parse the declarations of each file on -j threads
+        options.parallel = true;
+    } else if (arg == "--signatures-only") {  // skip function bodies
+        options.signatures_only = true;
+    } else if (arg == "--only") {  // print just the named function, parsing only its body
+        if (i + 1 < args.size()) {
+            options.only.push_back(args[++i]);
+        }
+    } else if (arg == "--max-nesting") {  // how deeply brackets may nest before it is an error
+        if (i + 1 < args.size()) {
+            options.tree.max_nesting = static_cast<unsigned>(std::max(atol(args[++i].c_str()), 1L));
+        }
+    } else if (arg == "--n-ary") {  // a run of one left-associative operator as one node
+        options.tree.n_ary = true;
+    } else if (arg.starts_with("--emit-ast=")) {  // "text" (the default), "bin", or "json"
+        string format = arg.substr(11);
+        if (format == "text") {
+            options.emit = Emit::TEXT;
+        } else if (format == "bin") {
+            options.emit = Emit::BINARY;
+        } else if (format == "json") {
+            options.emit = Emit::JSON;
+        } else {
+            error = "unknown AST format " + format;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void select_functions(Program& program, const vector<string>& names, bool bodies, std::string_view text,
+                      const TreeOptions& tree) {
+    std::erase_if(program.decls, [&](AST* decl) {
+        if (decl->kind != NK::FUNCTION) {
+            return true;
+        }
+        std::string_view name = program.symbols.text(static_cast<Function*>(decl)->decl.name);
+        return std::find(names.begin(), names.end(), name) == names.end();
+    });
+    program.spans.clear();  // no longer parallel to decls
+    program.owners.clear();
+    if (bodies) {
+        for (AST* decl : program.decls) {
+            expand(program, static_cast<Function*>(decl), text, tree);
+        }
+    }
+}
+
+void emit(const Program& program, const Options& options, Output& out) {
+    switch (options.emit) {
+        case Emit::TEXT:
+            if (options.parse) {
+                print_program(program, out, options.color);
+            }
+            break;
+        case Emit::BINARY:
+            write_ast(program, out);
+            break;
+        case Emit::JSON:
+            write_json(program, out);
+            break;
+    }
+}
+
+void compile(const string& file_name, const Options& options, Output& out) {
+    Lexer lexer(file_name, options.lex, out, options.color);
+    compile(lexer, options, out);
+}
+
+void compile(Lexer& lexer, const Options& options, Output& out) {
+    if (options.signatures_only || !options.only.empty()) {
+        // Function bodies are skipped, and only those asked for are parsed afterwards.
+        Parser parser(lexer, false, out, options.color);
+        parser.configure(options.tree);
+        parser.defer_bodies(true);
+        unique_ptr<Program> program = parser.program();
+        if (!options.only.empty()) {
+            select_functions(*program, options.only, !options.signatures_only, lexer.text(), options.tree);
+        }
+        emit(*program, options, out);
+        return;
+    }
+    // Entries are of binary nodes only, and were parsed under the default nesting limit.
+    bool cacheable = !options.tree.n_ary && options.tree.max_nesting == DEFAULT_NESTING;
+    const Cache* cache = cacheable ? options.cache : nullptr;
+    if (cache) {
+        if (std::optional<CacheEntry> hit = cache->load(lexer.text(), options.lex)) {
+            for (const Token& t : hit->tokens) {
+                lexer.echo(t);
+            }
+            emit(*hit->program, options, out);
+            return;
+        }
+    }
+    if (options.emit != Emit::BINARY && !options.parallel && !cache && !options.lex) {
+        // Each declaration is written and freed as soon as it is parsed. Printed tokens come all before the
+        // tree, and the cache needs all the declarations, so the program is kept whole in those cases.
+        auto run = [&](Parser& parser) {
+            Program local;
+            Program& program = options.workspace ? *options.workspace : local;
+            if (options.emit == Emit::JSON) {
+                parser.stream(program, [&](AST* decl, const SourceRange& span) {
+                    write_json(decl, &span, program.symbols, out);
+                    return false;
+                });
+                return;
+            }
+            std::optional<DeclarationPrinter> printer;
+            if (options.parse) {
+                printer.emplace(out, options.color, program.symbols);
+            }
+            parser.stream(program, [&](AST* decl, const SourceRange&) {
+                if (printer) {
+                    printer->print(decl, parser.done());
+                }
+                return false;
+            });
+        };
+        if (options.pipeline) {
+            Pipeline pipeline(lexer);
+            Parser parser(pipeline, false, out, options.color);
+            parser.configure(options.tree);
+            run(parser);
+        } else {
+            Parser parser(lexer, false, out, options.color);
+            parser.configure(options.tree);
+            run(parser);
+        }
+        return;
+    }
+    unique_ptr<Program> program;
+    if (options.parallel) {
+        program = parse_in_parallel(lexer, options.jobs, options.tree);
+    } else if (options.pipeline) {
+        Pipeline pipeline(lexer);
+        Parser parser(pipeline, false, out, options.color);
+        parser.configure(options.tree);
+        program = parser.program();
+    } else {
+        Parser parser(lexer, false, out, options.color);
+        parser.configure(options.tree);
+        program = parser.program();
+    }
+    emit(*program, options, out);
+    if (cache) {
+        cache->store(lexer.text(), *program);
+    }
+}
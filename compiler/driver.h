@@ -0,0 +1,52 @@
+#ifndef HEADER_DRIVER
+#define HEADER_DRIVER
+
+#include "lexer.h"
+#include "AST.h"
+#include "cache.h"
+#include "parser.h"
+
+// What the command line does with a file, for main and other front ends.
+
+// How the AST is written.
+enum struct Emit {
+    TEXT,    // the tree dump of AST.h
+    BINARY,  // the format of astfile.h
+    JSON     // a line per declaration, see json.h
+};
+
+struct Options {
+    bool lex = false;    // print tokens
+    bool parse = true;   // print the AST
+    Emit emit = Emit::TEXT;
+    bool stats = false;  // print allocation counts
+    bool color = true;
+    bool pipeline = false;  // lex on a separate thread
+    bool parallel = false;  // parse the declarations of a file in parallel
+    bool signatures_only = false;  // skip function bodies
+    vector<string> only;    // the functions to print, all declarations if empty
+    TreeOptions tree;
+    unsigned jobs = 1;
+    string cache_dir;       // where parse results are kept across runs, if set
+    size_t cache_size = 1024;  // MB
+    const Cache* cache = nullptr;
+    Program* workspace = nullptr;  // parse into this program when declarations are not kept, to reuse it
+};
+
+// Set the option args[i] in "options", with the value after it for those that take one (i is then moved on).
+// Returns false if args[i] is not an option of compile(); "error" is set if its value is wrong.
+bool set_option(const vector<string>& args, size_t& i, Options& options, string& error);
+
+// Keep only the functions named in "names", and parse their bodies if "bodies".
+void select_functions(Program& program, const vector<string>& names, bool bodies, std::string_view text,
+                      const TreeOptions& tree = {});
+
+// Write the AST of "program" in the format asked for.
+void emit(const Program& program, const Options& options, Output& out);
+
+// Lex and parse one file, or the source of "lexer", writing what "options" ask for to "out".
+// Errors are thrown as CompileError.
+void compile(const string& file_name, const Options& options, Output& out);
+void compile(Lexer& lexer, const Options& options, Output& out);
+
+#endif
@@ -1,18 +1,31 @@
 #include "error.h"
 
 
-// 打印报错信息并终止编译
-void print_error(std::string_view stage, std::string_view message, int line) {
-    cerr << COLOR_ERROR << std::format("error at line {}: ", line) << COLOR_RESET 
-         << message << endl
-         << "compilation failed: terminates at the " << stage << " stage" << endl;
-    exit(1);
+// 生成报错信息
+string error_text(const CompileError& error, bool color) {
+    string ret = color ? COLOR_ERROR : "";
+    if (error.stage.empty()) {
+        ret += "error: ";
+    } else {
+        ret += std::format("error at line {}: ", error.line);
+    }
+    ret += color ? COLOR_RESET : "";
+    ret += error.message;
+    ret += '\n';
+    if (!error.stage.empty()) {
+        ret += std::format("compilation failed: terminates at the {} stage\n", error.stage);
+    }
+    return ret;
+}
+
+void file_error(std::string_view message) {
+    throw CompileError{"", string(message), 0};
 }
 
 void lexer_error(std::string_view message, int line) {
-    print_error("lexing", message, line);
+    throw CompileError{"lexing", string(message), line};
 }
 
 void parser_error(std::string_view message, int line) {
-    print_error("parsing", message, line);
-}
\ No newline at end of file
+    throw CompileError{"parsing", string(message), line};
+}
@@ -29,8 +29,19 @@ using std::string;
 #define COLOR_RESET "\033[0m"
 
 
-// Compilation will be terminated upon encountering an error.
-void lexer_error(std::string_view message, int line);
-void parser_error(std::string_view message, int line);
+// Compilation of a file will be terminated upon encountering an error:
+// the error is thrown up to main, which reports it and goes on with the other files.
+struct CompileError {
+    std::string_view stage;  // "lexing" or "parsing", empty if the file could not be read
+    string message;
+    int line;
+};
+
+[[noreturn]] void file_error(std::string_view message);
+[[noreturn]] void lexer_error(std::string_view message, int line);
+[[noreturn]] void parser_error(std::string_view message, int line);
+
+// The report of an error, as printed to cerr.
+string error_text(const CompileError& error, bool color);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,542 @@
+#include "flat.h"
+
+// Converts a pointer tree into a FlatAST without recursion over the tree:
+// nodes are expanded on an explicit stack, and each finished node leaves its index on "results"
+// for its parent to pick up.
+class Flattener {
+public:
+    FlatAST ret;
+    uint32_t node(const AST* root);
+private:
+    struct Frame {
+        const AST* n;   // nullptr for an absent child
+        bool expanded;  // whether the children have been pushed
+    };
+    vector<Frame> frames;
+    vector<uint32_t> results;
+    void expand(const AST* n);
+    uint32_t build(const AST* n);
+    uint32_t add(FlatNode n);
+    uint32_t list(size_t count);
+    uint32_t type(const CType& t);
+    uint32_t declarator(const Declarator& d);
+    void push(const AST* n) { frames.push_back({n, false}); }
+};
+
+uint32_t Flattener::node(const AST* root) {
+    // Nested calls (for array sizes in declarators) only use the stacks above these marks.
+    size_t base = frames.size();
+    push(root);
+    while (frames.size() != base) {
+        Frame f = frames.back();
+        frames.pop_back();
+        if (!f.n) {
+            results.push_back(NO_NODE);
+        } else if (!f.expanded) {
+            frames.push_back({f.n, true});
+            expand(f.n);
+        } else {
+            uint32_t i = build(f.n);
+            results.push_back(i);
+        }
+    }
+    uint32_t ret = results.back();
+    results.pop_back();
+    return ret;
+}
+
+// Push the children of n in reverse order, so they are finished in source order.
+void Flattener::expand(const AST* n) {
+    switch (n->kind) {
+        case NK::EXPRESSION: {
+            auto e = static_cast<const Expression*>(n);
+            if (e->left) {
+                if (e->right) {
+                    push(e->right);
+                }
+                if (e->mid) {
+                    push(e->mid);
+                }
+                push(e->left);
+            } else {
+                for (auto it = e->call.end(); it != e->call.begin(); ) {
+                    push(*--it);
+                }
+            }
+            break;
+        }
+        case NK::CHAIN: {
+            auto e = static_cast<const Chain*>(n);
+            for (auto it = e->operands.end(); it != e->operands.begin(); ) {
+                push(*--it);
+            }
+            break;
+        }
+        case NK::RETURN:
+            push(static_cast<const ReturnStatement*>(n)->exp);
+            break;
+        case NK::IF: {
+            auto s = static_cast<const IfStatement*>(n);
+            push(s->_else);
+            push(s->then);
+            push(s->cond);
+            break;
+        }
+        case NK::WHILE: {
+            auto s = static_cast<const WhileStatement*>(n);
+            push(s->body);
+            push(s->cond);
+            break;
+        }
+        case NK::DO: {
+            auto s = static_cast<const DoStatement*>(n);
+            push(s->cond);
+            push(s->body);
+            break;
+        }
+        case NK::FOR: {
+            auto s = static_cast<const ForStatement*>(n);
+            push(s->body);
+            push(s->inc);
+            push(s->cond);
+            push(s->init);
+            break;
+        }
+        case NK::BLOCK: {
+            auto s = static_cast<const Block*>(n);
+            for (auto it = s->items.end(); it != s->items.begin(); ) {
+                push(*--it);
+            }
+            break;
+        }
+        case NK::EXP_STATEMENT:
+            push(static_cast<const ExpStatement*>(n)->exp);
+            break;
+        case NK::INITIALIZER: {
+            auto s = static_cast<const Initializer*>(n);
+            if (s->exp) {
+                push(s->exp);
+            } else {
+                for (auto it = s->init_list.end(); it != s->init_list.begin(); ) {
+                    push(*--it);
+                }
+            }
+            break;
+        }
+        case NK::VARIABLE:
+            push(static_cast<const Variable*>(n)->initializer);
+            break;
+        case NK::FUNCTION:
+            push(static_cast<const Function*>(n)->body);
+            break;
+        default:
+            break;
+    }
+}
+
+// Pop the children of n from "results" and add n itself.
+uint32_t Flattener::build(const AST* n) {
+    auto pop = [&]() {
+        uint32_t i = results.back();
+        results.pop_back();
+        return i;
+    };
+    FlatNode ret{};
+    switch (n->kind) {
+        case NK::CONSTANT:
+            ret.kind = FK::CONSTANT;
+            ret.a = static_cast<uint32_t>(static_cast<const Constant*>(n)->val);
+            break;
+        case NK::EXPRESSION: {
+            auto e = static_cast<const Expression*>(n);
+            ret.op = e->op;
+            if (e->left) {
+                if (e->mid) {
+                    ret.kind = FK::TERNARY;
+                    ret.c = pop();
+                    ret.b = pop();
+                    ret.a = pop();
+                } else if (e->right) {
+                    ret.kind = FK::BINARY;
+                    ret.b = pop();
+                    ret.a = pop();
+                } else {
+                    ret.kind = FK::UNARY;
+                    ret.a = pop();
+                }
+            } else if (e->is_call) {
+                ret.kind = FK::CALL;
+                ret.a = e->name;
+                ret.b = list(e->call.size());
+                ret.c = static_cast<uint32_t>(e->call.size());
+            } else {
+                ret.kind = FK::IDENTIFIER;
+                ret.a = e->name;
+            }
+            break;
+        }
+        case NK::CHAIN: {
+            auto e = static_cast<const Chain*>(n);
+            ret.kind = FK::CHAIN;
+            ret.op = e->op;
+            ret.b = list(e->operands.size());
+            ret.c = static_cast<uint32_t>(e->operands.size());
+            break;
+        }
+        case NK::EMPTY:
+            ret.kind = FK::EMPTY;
+            break;
+        case NK::CONTINUE:
+            ret.kind = FK::CONTINUE;
+            break;
+        case NK::BREAK:
+            ret.kind = FK::BREAK;
+            break;
+        case NK::RETURN:
+            ret.kind = FK::RETURN;
+            ret.a = pop();
+            break;
+        case NK::IF:
+            ret.kind = FK::IF;
+            ret.c = pop();
+            ret.b = pop();
+            ret.a = pop();
+            break;
+        case NK::WHILE:
+            ret.kind = FK::WHILE;
+            ret.b = pop();
+            ret.a = pop();
+            break;
+        case NK::DO:
+            ret.kind = FK::DO;
+            ret.b = pop();
+            ret.a = pop();
+            break;
+        case NK::FOR:
+            ret.kind = FK::FOR;
+            ret.a = list(4);
+            break;
+        case NK::BLOCK: {
+            auto s = static_cast<const Block*>(n);
+            ret.kind = FK::BLOCK;
+            ret.b = list(s->items.size());
+            ret.c = static_cast<uint32_t>(s->items.size());
+            break;
+        }
+        case NK::EXP_STATEMENT:
+            ret.kind = FK::EXP_STATEMENT;
+            ret.a = pop();
+            break;
+        case NK::INITIALIZER: {
+            auto s = static_cast<const Initializer*>(n);
+            if (s->exp) {
+                ret.kind = FK::INITIALIZER;
+                ret.a = pop();
+            } else {
+                ret.kind = FK::INITIALIZER_LIST;
+                ret.b = list(s->init_list.size());
+                ret.c = static_cast<uint32_t>(s->init_list.size());
+            }
+            break;
+        }
+        case NK::VARIABLE: {
+            auto s = static_cast<const Variable*>(n);
+            ret.kind = FK::VARIABLE;
+            ret.c = pop();
+            ret.a = type(s->type);
+            ret.b = declarator(s->decl);
+            break;
+        }
+        case NK::FUNCTION: {
+            auto s = static_cast<const Function*>(n);
+            ret.kind = FK::FUNCTION;
+            ret.c = pop();
+            ret.a = type(s->type);
+            ret.b = declarator(s->decl);
+            break;
+        }
+        default:
+            break;
+    }
+    return add(ret);
+}
+
+uint32_t Flattener::add(FlatNode n) {
+    ret.nodes.push_back(n);
+    return static_cast<uint32_t>(ret.nodes.size() - 1);
+}
+
+// Move the last "count" results into "extra", keeping their order.
+uint32_t Flattener::list(size_t count) {
+    uint32_t start = static_cast<uint32_t>(ret.extra.size());
+    ret.extra.insert(ret.extra.end(), results.end() - count, results.end());
+    results.resize(results.size() - count);
+    return start;
+}
+
+uint32_t Flattener::type(const CType& t) {
+    ret.types.push_back({t.storage, t.modifier, t.type, t.name});
+    return static_cast<uint32_t>(ret.types.size() - 1);
+}
+
+uint32_t Flattener::declarator(const Declarator& d) {
+    FlatDeclarator fd{d.name, static_cast<uint32_t>(d.depth), 0, 0, 0, 0};
+    // parameters are converted first, since their own declarators are appended too
+    vector<FlatParameter> params;
+    for (const Parameter& p : d.parameters) {
+        params.push_back({type(p.type), declarator(p.decl)});
+    }
+    fd.params = static_cast<uint32_t>(ret.parameters.size());
+    fd.param_count = static_cast<uint32_t>(params.size());
+    ret.parameters.insert(ret.parameters.end(), params.begin(), params.end());
+    for (const Expression* e : d.indexes) {
+        results.push_back(node(e));
+    }
+    fd.index_count = static_cast<uint32_t>(d.indexes.size());
+    fd.indexes = list(d.indexes.size());
+    ret.declarators.push_back(fd);
+    return static_cast<uint32_t>(ret.declarators.size() - 1);
+}
+
+FlatAST flatten(const Program& program) {
+    Flattener f;
+    vector<uint32_t> decls;
+    for (const AST* d : program.decls) {
+        decls.push_back(f.node(d));
+    }
+    FlatNode root{FK::PROGRAM};
+    root.b = static_cast<uint32_t>(f.ret.extra.size());
+    root.c = static_cast<uint32_t>(decls.size());
+    f.ret.extra.insert(f.ret.extra.end(), decls.begin(), decls.end());
+    f.ret.nodes.push_back(root);
+    f.ret.root = static_cast<uint32_t>(f.ret.nodes.size() - 1);
+    return std::move(f.ret);
+}
+
+void FlatView::children(uint32_t i, vector<uint32_t>& out) const {
+    const FlatNode& n = nodes[i];
+    auto add = [&](uint32_t c) {
+        if (c != NO_NODE) {
+            out.push_back(c);
+        }
+    };
+    auto add_list = [&](uint32_t start, uint32_t count) {
+        for (uint32_t c : list(start, count)) {
+            add(c);
+        }
+    };
+    switch (n.kind) {
+        case FK::PROGRAM:
+        case FK::BLOCK:
+        case FK::INITIALIZER_LIST:
+        case FK::CALL:
+        case FK::CHAIN:
+            add_list(n.b, n.c);
+            break;
+        case FK::UNARY:
+        case FK::RETURN:
+        case FK::EXP_STATEMENT:
+        case FK::INITIALIZER:
+            add(n.a);
+            break;
+        case FK::BINARY:
+        case FK::WHILE:
+        case FK::DO:
+            add(n.a);
+            add(n.b);
+            break;
+        case FK::TERNARY:
+        case FK::IF:
+            add(n.a);
+            add(n.b);
+            add(n.c);
+            break;
+        case FK::FOR:
+            add_list(n.a, 4);
+            break;
+        case FK::VARIABLE:
+        case FK::FUNCTION: {
+            const FlatDeclarator& d = declarators[n.b];
+            add_list(d.indexes, d.index_count);
+            add(n.c);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+size_t FlatAST::bytes() const {
+    return nodes.size() * sizeof(FlatNode) + extra.size() * sizeof(uint32_t)
+         + types.size() * sizeof(FlatType) + declarators.size() * sizeof(FlatDeclarator)
+         + parameters.size() * sizeof(FlatParameter);
+}
+
+// Children come before their parent, so the nodes are built in one pass in index order.
+class Unflattener {
+public:
+    Unflattener(const FlatView& f, Arena& a) : flat(f), arena(a), built(f.nodes.size(), nullptr) {}
+    void build(uint32_t i);
+    AST* at(uint32_t i) const { return i == NO_NODE ? nullptr : built[i]; }
+    template <class T>
+    T* get(uint32_t i) const { return static_cast<T*>(at(i)); }
+private:
+    const FlatView& flat;
+    Arena& arena;
+    vector<AST*> built;
+    vector<AST*> scratch;
+    template <class T>
+    List<T*> list(uint32_t start, uint32_t count);
+    CType type(uint32_t i) const;
+    Declarator declarator(uint32_t i);
+};
+
+template <class T>
+List<T*> Unflattener::list(uint32_t start, uint32_t count) {
+    scratch.clear();
+    for (uint32_t c : flat.list(start, count)) {
+        scratch.push_back(at(c));
+    }
+    return arena.list<T*>(scratch.begin(), scratch.end());
+}
+
+CType Unflattener::type(uint32_t i) const {
+    const FlatType& t = flat.types[i];
+    CType ret(t.type, t.name);
+    ret.storage = t.storage;
+    ret.modifier = t.modifier;
+    return ret;
+}
+
+Declarator Unflattener::declarator(uint32_t i) {
+    const FlatDeclarator& d = flat.declarators[i];
+    Declarator ret(d.name);
+    ret.depth = static_cast<int>(d.depth);
+    vector<Parameter> params;
+    for (uint32_t p = d.params; p != d.params + d.param_count; ++p) {
+        params.emplace_back(type(flat.parameters[p].type), declarator(flat.parameters[p].decl));
+    }
+    ret.parameters = arena.list<Parameter>(params.begin(), params.end());
+    ret.indexes = list<Expression>(d.indexes, d.index_count);
+    return ret;
+}
+
+void Unflattener::build(uint32_t i) {
+    const FlatNode& n = flat.nodes[i];
+    AST* ret = nullptr;
+    switch (n.kind) {
+        case FK::CONSTANT:
+            ret = arena.make<Constant>(static_cast<int>(n.a));
+            break;
+        case FK::IDENTIFIER:
+        case FK::CALL: {
+            Expression* e = arena.make<Expression>(n.a);
+            e->op = n.op;
+            if (n.kind == FK::CALL) {
+                e->is_call = true;
+                e->call = list<Expression>(n.b, n.c);
+            }
+            ret = e;
+            break;
+        }
+        case FK::UNARY:
+        case FK::BINARY:
+        case FK::TERNARY: {
+            Expression* e = arena.make<Expression>(get<Expression>(n.a), n.op);
+            if (n.kind == FK::TERNARY) {
+                e->mid = get<Expression>(n.b);
+                e->right = get<Expression>(n.c);
+            } else if (n.kind == FK::BINARY) {
+                e->right = get<Expression>(n.b);
+            }
+            ret = e;
+            break;
+        }
+        case FK::CHAIN: {
+            Chain* e = arena.make<Chain>(n.op);
+            e->operands = list<Expression>(n.b, n.c);
+            ret = e;
+            break;
+        }
+        case FK::EMPTY:
+            ret = arena.make<Statement>();
+            break;
+        case FK::CONTINUE:
+            ret = arena.make<ContinueStatement>();
+            break;
+        case FK::BREAK:
+            ret = arena.make<BreakStatement>();
+            break;
+        case FK::RETURN:
+            ret = arena.make<ReturnStatement>(get<Expression>(n.a));
+            break;
+        case FK::IF: {
+            IfStatement* s = arena.make<IfStatement>(get<Expression>(n.a), get<Statement>(n.b));
+            s->_else = get<Statement>(n.c);
+            ret = s;
+            break;
+        }
+        case FK::WHILE:
+            ret = arena.make<WhileStatement>(get<Expression>(n.a), get<Statement>(n.b));
+            break;
+        case FK::DO:
+            ret = arena.make<DoStatement>(get<Statement>(n.a), get<Expression>(n.b));
+            break;
+        case FK::FOR: {
+            std::span<const uint32_t> parts = flat.list(n.a, 4);
+            ForStatement* s = arena.make<ForStatement>();
+            s->init = at(parts[0]);
+            s->cond = get<Expression>(parts[1]);
+            s->inc = get<Expression>(parts[2]);
+            s->body = get<Statement>(parts[3]);
+            ret = s;
+            break;
+        }
+        case FK::BLOCK: {
+            Block* s = arena.make<Block>();
+            s->items = list<AST>(n.b, n.c);
+            ret = s;
+            break;
+        }
+        case FK::EXP_STATEMENT:
+            ret = arena.make<ExpStatement>(get<Expression>(n.a));
+            break;
+        case FK::INITIALIZER:
+            ret = arena.make<Initializer>(get<Expression>(n.a));
+            break;
+        case FK::INITIALIZER_LIST: {
+            Initializer* s = arena.make<Initializer>();
+            s->init_list = list<Initializer>(n.b, n.c);
+            ret = s;
+            break;
+        }
+        case FK::VARIABLE: {
+            Variable* s = arena.make<Variable>(type(n.a), declarator(n.b));
+            s->init(get<Initializer>(n.c));
+            ret = s;
+            break;
+        }
+        case FK::FUNCTION: {
+            Function* s = arena.make<Function>(type(n.a), declarator(n.b));
+            s->body = get<Block>(n.c);
+            ret = s;
+            break;
+        }
+        default:
+            break;
+    }
+    built[i] = ret;
+}
+
+void unflatten(const FlatView& flat, Program& program) {
+    Unflattener u(flat, program.arena);
+    for (uint32_t i = 0; i != flat.nodes.size(); ++i) {
+        u.build(i);
+    }
+    if (flat.root != NO_NODE) {
+        const FlatNode& root = flat.nodes[flat.root];
+        for (uint32_t d : flat.list(root.b, root.c)) {
+            program.decls.push_back(u.at(d));
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#ifndef HEADER_FLAT
+#define HEADER_FLAT
+
+#include <cstdint>
+#include <span>
+
+#include "AST.h"
+
+// Flat AST: all nodes in one contiguous array, linked by 32-bit indices instead of pointers.
+// Children always come before their parent, so the root is the last node.
+//
+// Payload of each kind (a, b, c of FlatNode):
+//   PROGRAM, BLOCK, INITIALIZER_LIST  -  b, c = list of children
+//   CONSTANT          a = value
+//   IDENTIFIER        a = Symbol
+//   CALL              a = Symbol, b, c = list of arguments
+//   UNARY             op, a = operand
+//   BINARY            op, a = left, b = right
+//   CHAIN             op, b, c = list of operands
+//   TERNARY           a = condition, b = then, c = else
+//   RETURN, EXP_STATEMENT, INITIALIZER  -  a = expression
+//   IF                a = condition, b = then, c = else
+//   WHILE             a = condition, b = body
+//   DO                a = body, b = condition
+//   FOR               a = index of 4 entries in "extra": initialization, condition, increment, body
+//   VARIABLE          a = index in "types", b = index in "declarators", c = initializer
+//   FUNCTION          a = index in "types", b = index in "declarators", c = body
+// A list is stored as (start, count) in "extra", and an absent child is NO_NODE.
+// Symbols are ids in the interner of the flattened Program.
+
+// flat node kind
+enum struct FK : uint8_t {
+    PROGRAM,
+    // expression
+    CONSTANT,
+    IDENTIFIER,
+    CALL,
+    UNARY,
+    BINARY,
+    TERNARY,
+    CHAIN,
+    // statement
+    EMPTY,
+    CONTINUE,
+    BREAK,
+    RETURN,
+    IF,
+    WHILE,
+    DO,
+    FOR,
+    BLOCK,
+    EXP_STATEMENT,
+    // declaration
+    INITIALIZER,
+    INITIALIZER_LIST,
+    VARIABLE,
+    FUNCTION
+};
+
+constexpr uint32_t NO_NODE = UINT32_MAX;
+
+struct FlatNode {
+    FK kind;
+    OP op = OP::NONE;
+    uint16_t reserved = 0;  // set, so written images are the same byte for byte
+    uint32_t a = NO_NODE;
+    uint32_t b = NO_NODE;
+    uint32_t c = NO_NODE;
+};
+
+struct FlatType {
+    CS storage;
+    CS modifier;
+    CS type;
+    Symbol name;
+};
+
+struct FlatDeclarator {
+    Symbol name;
+    uint32_t depth;
+    uint32_t params;       // (start, count) in "parameters"
+    uint32_t param_count;
+    uint32_t indexes;      // (start, count) in "extra"
+    uint32_t index_count;
+};
+
+struct FlatParameter {
+    uint32_t type;         // index in "types"
+    uint32_t decl;         // index in "declarators"
+};
+
+// The arrays of a flat AST without owning them, e.g., as stored in a mapped file (see astfile.h).
+struct FlatView {
+    std::span<const FlatNode> nodes;
+    std::span<const uint32_t> extra;
+    std::span<const FlatType> types;
+    std::span<const FlatDeclarator> declarators;
+    std::span<const FlatParameter> parameters;
+    uint32_t root = NO_NODE;
+
+    const FlatNode& operator[](uint32_t i) const { return nodes[i]; }
+    std::span<const uint32_t> list(uint32_t start, uint32_t count) const {
+        return extra.subspan(start, count);
+    }
+    // Children of node i in source order, absent ones skipped.
+    void children(uint32_t i, vector<uint32_t>& out) const;
+    // Call visit(index, depth) for every node under "from" (the root by default) in pre-order.
+    // The walk keeps its own stack, so any depth is fine.
+    template <class F>
+    void walk(F visit, uint32_t from = NO_NODE) const;
+};
+
+struct FlatAST {
+    vector<FlatNode> nodes;
+    vector<uint32_t> extra;
+    vector<FlatType> types;
+    vector<FlatDeclarator> declarators;
+    vector<FlatParameter> parameters;
+    uint32_t root = NO_NODE;
+
+    FlatView view() const { return {nodes, extra, types, declarators, parameters, root}; }
+    const FlatNode& operator[](uint32_t i) const { return nodes[i]; }
+    std::span<const uint32_t> list(uint32_t start, uint32_t count) const {
+        return {extra.data() + start, count};
+    }
+    void children(uint32_t i, vector<uint32_t>& out) const { view().children(i, out); }
+    template <class F>
+    void walk(F visit, uint32_t from = NO_NODE) const { view().walk(visit, from); }
+    size_t bytes() const;
+};
+
+FlatAST flatten(const Program& program);
+
+// The reverse of flatten(): add the declarations of "flat" to "program", with the nodes in its arena.
+// Symbols are taken to be ids in program.symbols, so the names must be interned in the same order first.
+void unflatten(const FlatView& flat, Program& program);
+
+template <class F>
+void FlatView::walk(F visit, uint32_t from) const {
+    if (from == NO_NODE) {
+        from = root;
+    }
+    vector<std::pair<uint32_t, int>> stack = {{from, 0}};
+    vector<uint32_t> kids;
+    while (!stack.empty()) {
+        auto [i, depth] = stack.back();
+        stack.pop_back();
+        visit(i, depth);
+        kids.clear();
+        children(i, kids);
+        for (auto it = kids.rbegin(); it != kids.rend(); ++it) {
+            stack.push_back({*it, depth + 1});
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#include "parser.h"
+#include "parallel.h"
+#include "gardenia.h"
+
+ParseResult parse(std::string_view source, const ParseOptions& options) {
+    ParseResult ret;
+    try {
+        Lexer lexer(source.data(), source.size(), false);
+        if (options.jobs > 1 && !options.signatures_only) {
+            ret.program = parse_in_parallel(lexer, options.jobs, options.tree);
+        } else {
+            Parser parser(lexer, false);
+            parser.configure(options.tree);
+            parser.defer_bodies(options.signatures_only);
+            ret.program = parser.program();
+        }
+    } catch (const CompileError& e) {
+        ret.program = nullptr;
+        ret.diagnostics.push_back(e);
+    }
+    return ret;
+}
+
+ParseResult parse_file(const string& path, const ParseOptions& options) {
+    try {
+        Source source(path);
+        return parse(source.view(), options);
+    } catch (const CompileError& e) {
+        ParseResult ret;
+        ret.diagnostics.push_back(e);
+        return ret;
+    }
+}
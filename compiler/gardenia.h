@@ -0,0 +1,35 @@
+#ifndef HEADER_GARDENIA
+#define HEADER_GARDENIA
+
+#include <string_view>
+
+#include "AST.h"
+#include "parser.h"
+
+// The interface for embedding gardenia, e.g., in a long-running tool: source in memory goes in,
+// and a Program or the errors come out. Nothing is printed and errors in the source are not thrown,
+// so one call never affects the next. Calls on different threads are independent.
+
+// An error in the source, as thrown inside the library.
+using Diagnostic = CompileError;
+
+struct ParseOptions {
+    bool signatures_only = false;  // skip function bodies, see Parser::defer_bodies()
+    unsigned jobs = 1;             // parse the declarations on this many threads, if more than one
+    TreeOptions tree;              // see parser.h
+};
+
+struct ParseResult {
+    unique_ptr<Program> program;    // null if the source has an error
+    vector<Diagnostic> diagnostics; // parsing stops at the first error, so there is one at most for now
+    explicit operator bool() const { return program != nullptr; }
+};
+
+// Parse "source", which need not outlive the call: the Program keeps copies of the names.
+// Only the ranges of skipped function bodies refer to it, by offset.
+ParseResult parse(std::string_view source, const ParseOptions& options = {});
+
+// Parse a file, reporting a file that cannot be read as a diagnostic too.
+ParseResult parse_file(const string& path, const ParseOptions& options = {});
+
+#endif
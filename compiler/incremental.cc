@@ -0,0 +1,189 @@
+#include <algorithm>
+
+#include "error.h"
+#include "scan.h"
+#include "parser.h"
+#include "incremental.h"
+
+Edit difference(std::string_view before, std::string_view after) {
+    size_t prefix = std::mismatch(before.begin(), before.end(), after.begin(), after.end()).first - before.begin();
+    size_t most = std::min(before.size(), after.size()) - prefix;
+    size_t suffix = 0;
+    while (suffix < most && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    return {prefix, before.size() - prefix - suffix, after.size() - prefix - suffix};
+}
+
+// How the positions after the last edited part moved.
+struct Shift {
+    ptrdiff_t offset = 0;
+    int rows = 0;
+    int row = -1;  // the old row where that part ended, whose columns moved too
+    int cols = 0;
+    SourceRange operator()(SourceRange r) const {
+        if (r.row == row) {
+            r.col += cols;
+        }
+        r.row += rows;
+        r.offset += offset;
+        return r;
+    }
+};
+
+// Parse the declarations in [from.offset, end) of "text", with "from" as the position of its start.
+static void parse_range(std::string_view text, const SourceRange& from, size_t end, Interner& symbols,
+                        Arena& arena, vector<AST*>& decls, vector<SourceRange>& spans) {
+    Lexer lexer(text.data() + from.offset, end - from.offset, false);
+    lexer.set_position(from.row, from.col, from.offset);
+    Parser parser(lexer, false);
+    parser.use_symbols(symbols);
+    parser.declarations(arena, decls, spans);
+}
+
+// Whether lexing [begin, end) surely stops between tokens at "end", the same as lexing on past it:
+// a comment on the last line might go on instead.
+static bool ends_cleanly(std::string_view text, size_t begin, size_t end) {
+    size_t line = text.rfind('\n', end - 1);
+    line = line == std::string_view::npos || line < begin ? begin : line + 1;
+    return text.substr(line, end - line).find('/') == std::string_view::npos;
+}
+
+// Make "decls" the declarations of "program", with "owners" indexing its parts followed by "arenas",
+// and free the parts no declaration is in any more.
+static void replace(Program& program, vector<AST*>& decls, vector<SourceRange>& spans, vector<uint32_t>& owners,
+                    vector<Arena>& arenas) {
+    for (Arena& arena : arenas) {
+        program.parts.push_back(std::move(arena));
+    }
+    vector<uint32_t> index(program.parts.size(), Program::IN_ARENA);
+    for (uint32_t o : owners) {
+        if (o != Program::IN_ARENA) {
+            index[o] = 0;
+        }
+    }
+    uint32_t kept = 0;
+    for (size_t p = 0; p != program.parts.size(); ++p) {
+        if (index[p] != Program::IN_ARENA) {
+            index[p] = kept;
+            if (p != kept) {
+                program.parts[kept] = std::move(program.parts[p]);
+            }
+            ++kept;
+        }
+    }
+    program.parts.erase(program.parts.begin() + kept, program.parts.end());
+    for (uint32_t& o : owners) {
+        if (o != Program::IN_ARENA) {
+            o = index[o];
+        }
+    }
+    program.decls = std::move(decls);
+    program.spans = std::move(spans);
+    program.owners = std::move(owners);
+}
+
+void reparse(Program& program, std::string_view text, const vector<Edit>& edits) {
+    const vector<SourceRange>& spans = program.spans;
+    size_t n = program.decls.size();
+    vector<AST*> decls;
+    vector<SourceRange> new_spans;
+    vector<uint32_t> owners;  // as in Program, counting "arenas" after the parts of the program
+    vector<Arena> arenas;
+    if (n == 0) {
+        arenas.emplace_back();
+        parse_range(text, {}, text.size(), program.symbols, arenas.back(), decls, new_spans);
+        owners.resize(decls.size(), static_cast<uint32_t>(program.parts.size()));
+        replace(program, decls, new_spans, owners, arenas);
+        return;
+    }
+
+    // An edit marks the declarations it touches, even at their ends, so one between two marks both.
+    // Without spans, e.g., after some declarations were dropped, everything is parsed again,
+    // and likewise if some are in parts not known to which, so that all the old parts can be freed.
+    bool known = spans.size() == n && (program.owners.size() == n || program.parts.empty());
+    vector<bool> dirty(n, !known);
+    if (known) {
+        for (const Edit& e : edits) {
+            auto it = std::lower_bound(spans.begin(), spans.end(), e.offset, [](const SourceRange& s, size_t o) {
+                return s.offset + s.length < o;
+            });
+            size_t i = std::min<size_t>(it - spans.begin(), n - 1);
+            dirty[i] = true;
+            for (; i != n && spans[i].offset <= e.offset + e.removed; ++i) {
+                dirty[i] = true;
+            }
+            if (e.offset <= spans[0].offset) {
+                dirty[0] = true;  // before the first declaration
+            }
+        }
+    }
+
+    // Nothing is changed until all the edited parts are parsed, so an error leaves the program as it was.
+    const ScanKernels& scan = scan_kernels();
+    vector<std::pair<Function*, SourceRange>> moved;  // skipped bodies of the declarations kept
+    Shift shift;
+    size_t e = 0;  // the first edit after the declarations done
+    size_t i = 0;
+    while (i != n) {
+        if (!dirty[i]) {
+            AST* decl = program.decls[i];
+            if (decl->kind == NK::FUNCTION) {
+                Function* f = static_cast<Function*>(decl);
+                if (f->deferred.length != 0) {
+                    moved.emplace_back(f, shift(f->deferred));
+                }
+            }
+            decls.push_back(decl);
+            new_spans.push_back(shift(spans[i]));
+            owners.push_back(program.owners.empty() ? Program::IN_ARENA : program.owners[i]);
+            ++i;
+            continue;
+        }
+        // Parse the edited declarations from i to j. In case of an error, or if the last one might not
+        // end where the next one starts, more are taken until the end of the file, which has the real error.
+        SourceRange from = i ? shift(spans[i]) : SourceRange{};
+        ptrdiff_t offset = shift.offset;
+        size_t j = i;
+        size_t end;
+        size_t mark = decls.size();
+        while (true) {
+            while (j != n && (j == i || dirty[j])) {
+                ++j;
+            }
+            for (; e != edits.size() && (j == n || edits[e].offset < spans[j].offset); ++e) {
+                offset += static_cast<ptrdiff_t>(edits[e].inserted) - static_cast<ptrdiff_t>(edits[e].removed);
+            }
+            end = j != n ? spans[j].offset + offset : text.size();
+            Arena arena;
+            try {
+                if (j == n || ends_cleanly(text, from.offset, end)) {
+                    parse_range(text, from, end, program.symbols, arena, decls, new_spans);
+                    owners.resize(decls.size(), static_cast<uint32_t>(program.parts.size() + arenas.size()));
+                    arenas.push_back(std::move(arena));
+                    break;
+                }
+            } catch (const CompileError&) {
+                if (j == n) {
+                    throw;
+                }
+            }
+            decls.resize(mark);
+            new_spans.resize(mark);
+            j = std::min(n, j + (j - i));
+        }
+        if (j != n) {
+            Lines lines = scan.count_lines(text.data() + from.offset, text.data() + end);
+            int row = from.row + static_cast<int>(lines.count);
+            int col = lines.count ? static_cast<int>(text.data() + end - lines.last)
+                                  : from.col + static_cast<int>(end - from.offset);
+            shift = {offset, row - spans[j].row, spans[j].row, col - spans[j].col};
+        }
+        i = j;
+    }
+
+    for (auto& [f, range] : moved) {
+        f->deferred = range;
+    }
+    replace(program, decls, new_spans, owners, arenas);
+}
@@ -0,0 +1,25 @@
+#ifndef HEADER_INCREMENTAL
+#define HEADER_INCREMENTAL
+
+#include "AST.h"
+
+// A change to the source: "removed" bytes at "offset" were replaced by "inserted" bytes.
+struct Edit {
+    size_t offset;
+    size_t removed;
+    size_t inserted;
+};
+
+// The single edit that turns "before" into "after", i.e., what lies between their common prefix and suffix.
+Edit difference(std::string_view before, std::string_view after);
+
+// Bring "program", parsed from some text, up to date with "text", i.e., that text after "edits".
+// Edits are in the offsets of the old text, sorted, and do not overlap.
+// Only the declarations an edit touches are lexed and parsed again (bodies included);
+// the others are kept as they are, with their positions shifted.
+// The new nodes go to arenas added to "parts", and the names to the same interner;
+// the parts left without declarations are freed, so memory follows the program and not the edits.
+// Errors are the same as for parsing the whole text, and leave "program" as it was.
+void reparse(Program& program, std::string_view text, const vector<Edit>& edits);
+
+#endif
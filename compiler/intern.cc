@@ -0,0 +1,13 @@
+#include "intern.h"
+
+Symbol Interner::intern(std::string_view s) {
+    auto it = ids.find(s);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    std::string_view text = storage.store(s);
+    Symbol id = static_cast<Symbol>(texts.size());
+    texts.push_back(text);
+    ids.emplace(text, id);
+    return id;
+}
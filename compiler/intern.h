@@ -0,0 +1,29 @@
+#ifndef HEADER_INTERN
+#define HEADER_INTERN
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+#include "lexer.h"
+
+// Dense 32-bit id of an interned identifier or literal.
+// Id 0 is always the empty string, i.e., "no name".
+using Symbol = uint32_t;
+
+// Maps each distinct text to a Symbol, so names are stored and compared as integers
+// and only turned back into text when printing.
+// Every Program has its own, so nothing is shared between files parsed in parallel.
+class Interner {
+public:
+    Interner() { intern(""); }
+    Symbol intern(std::string_view s);
+    std::string_view text(Symbol id) const { return texts[id]; }
+    size_t size() const { return texts.size(); }
+private:
+    std::unordered_map<std::string_view, Symbol> ids;  // keys point into "storage"
+    vector<std::string_view> texts;                    // indexed by Symbol
+    LiteralBuffer storage;
+};
+
+#endif
@@ -0,0 +1,368 @@
+#include "json.h"
+
+// Fields of each kind of node, after "kind":
+//   Constant             value
+//   Identifier           name
+//   Call                 name, arguments
+//   Unary                op, operand
+//   Binary               op, left, right
+//   Chain                op, operands (a run of one operator, see TreeOptions)
+//   Conditional          condition, then, else
+//   Empty, Continue, Break
+//   Return               value
+//   If                   condition, then, else
+//   While                condition, body
+//   Do                   body, condition
+//   For                  initialization, condition, increment, body
+//   Block                items
+//   ExpressionStatement  expression
+//   Initializer          value
+//   InitializerList      items
+//   Variable             type, declarator, initializer
+//   Function             type, declarator, body, and "skipped" (a range) if the body was not parsed
+// A top-level declaration also has the "row" and "col" where it starts, counted as in error messages.
+// A type is {storage, modifier, type, name}, without the fields that do not apply, and a declarator
+// {name, depth, parameters, indexes}, where each parameter is {type, declarator}. Absent children are null.
+
+void JsonWriter::string(std::string_view s) {
+    static constexpr char hex[] = "0123456789abcdef";
+    out << '"';
+    size_t done = 0;
+    for (size_t i = 0; i != s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out << s.substr(done, i - done);
+        done = i + 1;
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            case '\b': out << "\\b"; break;
+            case '\f': out << "\\f"; break;
+            default:
+                out << "\\u00" << hex[c >> 4] << hex[c & 15];
+                break;
+        }
+    }
+    out << s.substr(done) << '"';
+}
+
+// Writes a declaration without recursion over the tree, like the Printer: a node writes what it can
+// at once and schedules the rest (its children and the text between them) as tasks, run in order.
+class JsonEmitter {
+public:
+    JsonEmitter(const Interner& s, Output& o) : symbols(s), json(o) {}
+    void write(const AST* root, const SourceRange* span);
+private:
+    struct Task {
+        enum Kind : uint8_t { NODE, DECLARATOR, TEXT } kind;
+        const AST* node;
+        const Declarator* decl;
+        std::string_view text;
+    };
+    const Interner& symbols;
+    JsonWriter json;
+    vector<Task> tasks;    // what is left to do, the next task at the back
+    vector<Task> pending;  // tasks scheduled by the current node, in order
+    void node(const AST* n) { pending.push_back({Task::NODE, n, nullptr, {}}); }
+    void declarator(const Declarator& d) { pending.push_back({Task::DECLARATOR, nullptr, &d, {}}); }
+    void text(std::string_view s) { pending.push_back({Task::TEXT, nullptr, nullptr, s}); }
+    template <class T>
+    void list(const List<T*>& items) {
+        text("[");
+        for (auto it = items.begin(); it != items.end(); ++it) {
+            if (it != items.begin()) {
+                text(",");
+            }
+            node(*it);
+        }
+        text("]");
+    }
+    const SourceRange* position = nullptr;  // of the declaration being started
+    void kind(std::string_view name) {
+        json.raw("{\"kind\":\"");
+        json.raw(name);
+        json.raw("\"");
+        if (position) {
+            json.raw(",\"row\":");
+            json.number(position->row);
+            json.raw(",\"col\":");
+            json.number(position->col);
+            position = nullptr;
+        }
+    }
+    void visit(const AST* n);
+    void visit(const Declarator& d);
+    void type(const CType& t);
+    void range(const SourceRange& r);
+};
+
+void JsonEmitter::write(const AST* root, const SourceRange* span) {
+    position = span;
+    visit(root);
+    tasks.assign(pending.rbegin(), pending.rend());
+    pending.clear();
+    while (!tasks.empty()) {
+        Task t = tasks.back();
+        tasks.pop_back();
+        switch (t.kind) {
+            case Task::NODE:
+                visit(t.node);
+                break;
+            case Task::DECLARATOR:
+                visit(*t.decl);
+                break;
+            case Task::TEXT:
+                json.raw(t.text);
+                break;
+        }
+        tasks.insert(tasks.end(), pending.rbegin(), pending.rend());
+        pending.clear();
+    }
+    json.raw("\n");
+}
+
+// Write the start of a node and schedule the rest, which ends with its "}".
+void JsonEmitter::visit(const AST* n) {
+    if (!n) {
+        json.raw("null");
+        return;
+    }
+    switch (n->kind) {
+        // expression
+        case NK::CONSTANT:
+            kind("Constant");
+            json.raw(",\"value\":");
+            json.number(static_cast<const Constant*>(n)->val);
+            break;
+        case NK::EXPRESSION: {
+            auto e = static_cast<const Expression*>(n);
+            if (!e->left) {
+                kind(e->is_call ? "Call" : "Identifier");
+                json.raw(",\"name\":");
+                json.string(symbols.text(e->name));
+                if (e->is_call) {
+                    text(",\"arguments\":");
+                    list(e->call);
+                }
+            } else if (e->mid) {
+                kind("Conditional");
+                text(",\"condition\":");
+                node(e->left);
+                text(",\"then\":");
+                node(e->mid);
+                text(",\"else\":");
+                node(e->right);
+            } else {
+                kind(e->right ? "Binary" : "Unary");
+                json.raw(",\"op\":");
+                json.string(op_name(e->op));
+                text(e->right ? ",\"left\":" : ",\"operand\":");
+                node(e->left);
+                if (e->right) {
+                    text(",\"right\":");
+                    node(e->right);
+                }
+            }
+            break;
+        }
+        case NK::CHAIN: {
+            auto e = static_cast<const Chain*>(n);
+            kind("Chain");
+            json.raw(",\"op\":");
+            json.string(op_name(e->op));
+            text(",\"operands\":");
+            list(e->operands);
+            break;
+        }
+        // statement
+        case NK::EMPTY:
+            kind("Empty");
+            break;
+        case NK::CONTINUE:
+            kind("Continue");
+            break;
+        case NK::BREAK:
+            kind("Break");
+            break;
+        case NK::RETURN:
+            kind("Return");
+            text(",\"value\":");
+            node(static_cast<const ReturnStatement*>(n)->exp);
+            break;
+        case NK::IF: {
+            auto s = static_cast<const IfStatement*>(n);
+            kind("If");
+            text(",\"condition\":");
+            node(s->cond);
+            text(",\"then\":");
+            node(s->then);
+            text(",\"else\":");
+            node(s->_else);
+            break;
+        }
+        case NK::WHILE: {
+            auto s = static_cast<const WhileStatement*>(n);
+            kind("While");
+            text(",\"condition\":");
+            node(s->cond);
+            text(",\"body\":");
+            node(s->body);
+            break;
+        }
+        case NK::DO: {
+            auto s = static_cast<const DoStatement*>(n);
+            kind("Do");
+            text(",\"body\":");
+            node(s->body);
+            text(",\"condition\":");
+            node(s->cond);
+            break;
+        }
+        case NK::FOR: {
+            auto s = static_cast<const ForStatement*>(n);
+            kind("For");
+            text(",\"initialization\":");
+            node(s->init);
+            text(",\"condition\":");
+            node(s->cond);
+            text(",\"increment\":");
+            node(s->inc);
+            text(",\"body\":");
+            node(s->body);
+            break;
+        }
+        case NK::BLOCK:
+            kind("Block");
+            text(",\"items\":");
+            list(static_cast<const Block*>(n)->items);
+            break;
+        case NK::EXP_STATEMENT:
+            kind("ExpressionStatement");
+            text(",\"expression\":");
+            node(static_cast<const ExpStatement*>(n)->exp);
+            break;
+        // declaration
+        case NK::INITIALIZER: {
+            auto s = static_cast<const Initializer*>(n);
+            if (s->exp) {
+                kind("Initializer");
+                text(",\"value\":");
+                node(s->exp);
+            } else {
+                kind("InitializerList");
+                text(",\"items\":");
+                list(s->init_list);
+            }
+            break;
+        }
+        case NK::VARIABLE: {
+            auto s = static_cast<const Variable*>(n);
+            kind("Variable");
+            json.raw(",\"type\":");
+            type(s->type);
+            text(",\"declarator\":");
+            declarator(s->decl);
+            text(",\"initializer\":");
+            node(s->initializer);
+            break;
+        }
+        case NK::FUNCTION: {
+            auto s = static_cast<const Function*>(n);
+            kind("Function");
+            json.raw(",\"type\":");
+            type(s->type);
+            if (s->deferred.length != 0) {
+                json.raw(",\"skipped\":");
+                range(s->deferred);
+            }
+            text(",\"declarator\":");
+            declarator(s->decl);
+            text(",\"body\":");
+            node(s->body);
+            break;
+        }
+        case NK::PARAMETER: {
+            auto s = static_cast<const Parameter*>(n);
+            json.raw("{\"type\":");
+            type(s->type);
+            text(",\"declarator\":");
+            declarator(s->decl);
+            break;
+        }
+        default:
+            json.raw("{");
+            break;
+    }
+    text("}");
+}
+
+void JsonEmitter::visit(const Declarator& d) {
+    json.raw("{\"name\":");
+    if (d.name != 0) {
+        json.string(symbols.text(d.name));
+    } else {
+        json.raw("null");
+    }
+    json.raw(",\"depth\":");
+    json.number(d.depth);
+    json.raw(",\"parameters\":[");
+    for (auto it = d.parameters.begin(); it != d.parameters.end(); ++it) {
+        if (it != d.parameters.begin()) {
+            text(",");
+        }
+        node(&*it);
+    }
+    text("],\"indexes\":");
+    list(d.indexes);
+    text("}");
+}
+
+void JsonEmitter::type(const CType& t) {
+    json.raw("{");
+    if (t.storage != CS::NONE) {
+        json.raw(t.storage == CS::STATIC ? "\"storage\":\"static\"," : "\"storage\":\"extern\",");
+    }
+    if (t.modifier == CS::UNSIGNED) {
+        json.raw("\"modifier\":\"unsigned\",");
+    }
+    json.raw("\"type\":");
+    switch (t.type) {
+        case CS::STRUCT: json.raw("\"struct\",\"name\":"); json.string(symbols.text(t.name)); break;
+        case CS::VOID: json.raw("\"void\""); break;
+        case CS::CHAR: json.raw("\"char\""); break;
+        case CS::INT: json.raw("\"int\""); break;
+        case CS::LONG: json.raw("\"long\""); break;
+        case CS::DOUBLE: json.raw("\"double\""); break;
+        default: json.raw("null"); break;
+    }
+    json.raw("}");
+}
+
+void JsonEmitter::range(const SourceRange& r) {
+    json.raw("{\"offset\":");
+    json.number(static_cast<long>(r.offset));
+    json.raw(",\"length\":");
+    json.number(static_cast<long>(r.length));
+    json.raw(",\"row\":");
+    json.number(r.row);
+    json.raw(",\"col\":");
+    json.number(r.col);
+    json.raw("}");
+}
+
+void write_json(const AST* decl, const SourceRange* span, const Interner& symbols, Output& out) {
+    JsonEmitter(symbols, out).write(decl, span);
+}
+
+void write_json(const Program& program, Output& out) {
+    JsonEmitter emitter(program.symbols, out);
+    bool spans = program.spans.size() == program.decls.size();
+    for (size_t i = 0; i != program.decls.size(); ++i) {
+        emitter.write(program.decls[i], spans ? &program.spans[i] : nullptr);
+    }
+}
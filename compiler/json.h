@@ -0,0 +1,26 @@
+#ifndef HEADER_JSON
+#define HEADER_JSON
+
+#include "AST.h"
+
+// Writes JSON straight to an Output as it goes: nothing is kept but what the caller remembers.
+class JsonWriter {
+public:
+    JsonWriter(Output& o) : out(o) {}
+    // A string, quoted and escaped.
+    void string(std::string_view s);
+    void number(long v) { out << v; }
+    // Anything already in JSON, e.g., punctuation and keys.
+    void raw(std::string_view s) { out << s; }
+private:
+    Output& out;
+};
+
+// Write a top-level declaration as one line of JSON; "span", if given, is where it is in the source.
+// Every node is an object with its "kind", followed by its fields (see json.cc).
+void write_json(const AST* decl, const SourceRange* span, const Interner& symbols, Output& out);
+
+// Write each declaration of "program" as above.
+void write_json(const Program& program, Output& out);
+
+#endif
@@ -1,24 +1,43 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
 #include "lexer.h"
 
-void Token::print() {
-    cout << COLOR_CLASS
-         << "[" << std::format("{:>4}", std::to_string(row)) << ":"
-         << std::format("{:>4}", std::to_string(col)) << "] "
-         << COLOR_RESET;
+template <bool Color>
+void Token::print(Output& out) const {
+    if constexpr (Color) {
+        out << COLOR_CLASS;
+    }
+    out << '[';
+    out.pad(row, 4) << ':';
+    out.pad(col, 4) << "] ";
+    if constexpr (Color) {
+        out << COLOR_RESET;
+    }
     switch (type) {
         case TT::CHAR:
-            cout << "'" << value << "'";
+            out << '\'' << value << '\'';
             break;
         case TT::STRING:
-            cout << "\"" << value << "\"";
+            out << '"' << value << '"';
             break;
         default:
-            cout << value;
+            out << value;
     }
-    cout << endl;
+    out << '\n';
 }
 
-std::unordered_map<string, TT> get_token_type {
+template void Token::print<true>(Output& out) const;
+template void Token::print<false>(Output& out) const;
+
+struct Keyword {
+    std::string_view text;
+    TT type;
+};
+
+// To enable a keyword, just add it here: the hash table below is rebuilt at compile time.
+constexpr Keyword keywords[] = {
     // type
     {"static", TT::STATIC},
     {"extern", TT::EXTERN},
@@ -59,21 +78,92 @@ std::unordered_map<string, TT> get_token_type {
     // {"restrict", TokenType::KEYWORD},
 };
 
-std::unordered_map<char, char> get_escape_char {
-    {'\\', '\\'},
-    {'\'', '\''},
-    {'"', '\"'},
-    {'n', '\n'},
-    {'r', '\r'},
-    {'t', '\t'},
-    {'b', '\b'},
-    {'f', '\f'},
-    {'v', '\v'},
-    {'a', '\a'},
-    {'0', '\0'}
+// Perfect hash over the keywords: the length, the first two and the last character
+// are mixed, and the seed is searched at compile time until no two keywords collide.
+constexpr int KEYWORD_BITS = 7;  // table of 128 slots
+
+constexpr uint32_t keyword_hash(std::string_view s, uint32_t seed) {
+    uint32_t h = static_cast<uint32_t>(s.size());
+    h = h * 31 + static_cast<unsigned char>(s[0]);
+    h = h * 31 + static_cast<unsigned char>(s.size() > 1 ? s[1] : 0);
+    h = h * 31 + static_cast<unsigned char>(s.back());
+    return ((h ^ seed) * 0x9E3779B1u) >> (32 - KEYWORD_BITS);
+}
+
+struct KeywordTable {
+    uint32_t seed = 0;
+    std::array<int8_t, 1 << KEYWORD_BITS> slot{};  // index into keywords + 1, or 0 if empty
 };
 
-// Read the next character of the file.
+constexpr KeywordTable keyword_table = [] {
+    for (uint32_t seed = 1; seed < 100000; ++seed) {
+        KeywordTable t;
+        t.seed = seed;
+        bool ok = true;
+        for (size_t i = 0; ok && i != std::size(keywords); ++i) {
+            auto& s = t.slot[keyword_hash(keywords[i].text, seed)];
+            ok = (s == 0);
+            s = static_cast<int8_t>(i + 1);
+        }
+        if (ok) {
+            return t;
+        }
+    }
+    return KeywordTable();
+}();
+static_assert(keyword_table.seed != 0, "no perfect hash for the keywords, increase KEYWORD_BITS");
+
+// Type of an identifier-like word: the keyword type, or TT::IDENTIFIER.
+TT keyword_type(std::string_view s) {
+    int i = keyword_table.slot[keyword_hash(s, keyword_table.seed)];
+    if (i != 0 && keywords[i - 1].text == s) {
+        return keywords[i - 1].type;
+    }
+    return TT::IDENTIFIER;
+}
+
+// Value of the escape sequence "\e", or -1 if unknown.
+constexpr int escape_char(char e) {
+    switch (e) {
+        case '\\': return '\\';
+        case '\'': return '\'';
+        case '"': return '"';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'a': return '\a';
+        case '0': return '\0';
+        default: return -1;
+    }
+}
+
+// Every byte value once, so a decoded char literal can be viewed without storage.
+constexpr auto byte_table = [] {
+    std::array<char, 256> ret{};
+    for (int i = 0; i != 256; ++i) {
+        ret[i] = static_cast<char>(i);
+    }
+    return ret;
+}();
+
+std::string_view LiteralBuffer::store(std::string_view s) {
+    if (s.size() > left) {
+        left = std::max(s.size(), BLOCK_SIZE);
+        blocks.push_back(std::make_unique<char[]>(left));
+        free = blocks.back().get();
+    }
+    char* ret = free;
+    std::copy(s.begin(), s.end(), ret);
+    free += s.size();
+    left -= s.size();
+    return {ret, s.size()};
+}
+
+// Read the next character of the buffer.
+// A NUL byte is treated as the end of input as well.
 void Lexer::move_forward() {
     if (c == '\n') {
         ++row;
@@ -81,24 +171,103 @@ void Lexer::move_forward() {
     } else {
         ++col;
     }
-    file.get(c);
+    if (pos != end) {
+        ++pos;
+    }
+    c = (pos != end) ? *pos : '\0';
+}
+
+// Jump to q (at or after pos), counting the newlines skipped over.
+void Lexer::skip_to(const char* q) {
+    Lines lines = scan.count_lines(pos, q);
+    if (lines.count != 0) {
+        row += static_cast<int>(lines.count);
+        col = static_cast<int>(q - lines.last);
+    } else {
+        col += static_cast<int>(q - pos);
+    }
+    pos = q;
+    c = (pos != end) ? *pos : '\0';
+}
+
+// Jump to q (at or after pos) within the current line.
+void Lexer::skip_inline(const char* q) {
+    col += static_cast<int>(q - pos);
+    pos = q;
+    c = (pos != end) ? *pos : '\0';
+}
+
+// Skip the rest of a block whose "{" was the last token, up to and including the matching "}",
+// without making tokens. Strings, chars and comments are skipped as a whole, so their braces don't count.
+// Returns false if the input ends first.
+bool Lexer::skip_block() {
+    const char* p = pos;
+    int depth = 1;
+    while (p != end && *p != '\0') {
+        switch (*p++) {
+            case '{':
+                ++depth;
+                break;
+            case '}':
+                if (--depth == 0) {
+                    skip_to(p);
+                    return true;
+                }
+                break;
+            case '"':
+                while (true) {
+                    p = scan.find_string_end(p, end);
+                    if (p == end || *p != '\\') {
+                        break;
+                    }
+                    p += (p + 1 != end) ? 2 : 1;  // escape character
+                }
+                if (p != end && *p == '"') {
+                    ++p;
+                }
+                break;
+            case '\'':
+                while (p != end && *p != '\'' && *p != '\n' && *p != '\0') {
+                    p += (*p == '\\' && p + 1 != end) ? 2 : 1;
+                }
+                if (p != end && *p == '\'') {
+                    ++p;
+                }
+                break;
+            case '/':
+                if (p != end && *p == '/') {
+                    p = scan.find_line_end(p, end);
+                } else if (p != end && *p == '*') {
+                    p = scan.find_comment_end(p + 1, end);
+                    if (p != end && *p == '/') {
+                        ++p;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    skip_to(p);
+    return false;
 }
 
 // Get the next token, and print it if required.
 Token Lexer::next() {
     Token ret = next_token();
-    if (lex_flag && ret.type != TT::END) {
-        ret.print();
-    }
+    ret.offset = origin + (token_start - source.begin());
+    ++tokens;
+    echo(ret);
     return ret;
 }
 
 Token Lexer::next_token() {
-    while (!file.eof()) {
+    while (c != '\0') {
         if (isspace(c)) {              // skip all kinds of space
-            move_forward();
+            skip_to(scan.skip_space(pos, end));
             continue;
         }
+        token_start = pos;
         if (c == '/') {                // maybe a comment
             Token t = next_comment();
             if (t.type != TT::COMMENT) {
@@ -120,35 +289,30 @@ Token Lexer::next_token() {
         }
         return next_symbol();          // operator or symbol
     }
-    file.close();
+    token_start = pos;
     return Token(TT::END, "", row, col);
 }
 
 Token Lexer::next_comment() {
     Token ret(TT::COMMENT, "/", row, col);
-    bool maybe_end = false;
     move_forward();
     switch(c) {
         case '/':           // single-line comment
-            while (c != '\n' && !file.eof()) {
-                move_forward();
-            }
+            skip_inline(scan.find_line_end(pos, end));
             return ret;
-        case '*':           // multi-line comment
-            while (true) {  // can only ends with "*/"
-                move_forward();
-                if (file.eof()) {
-                    lexer_error("unterminated comment", ret.row);
-                } else if (maybe_end || c == '/'){
-                    move_forward();
-                    return ret;
-                }
-                maybe_end = (c == '*');
+        case '*':           // multi-line comment, can only ends with "*/"
+            skip_to(scan.find_comment_end(pos + 1, end));
+            if (c == '\0') {
+                lexer_error("unterminated comment", ret.row);
             }
+            move_forward();
+            return ret;
         default:            // operator "/" or "/="
             ret.type = TT::OPERATOR;
+            ret.op = OP::DIV;
             if (c == '=') {
                 ret.value = "/=";
+                ret.op = OP::DIV_ASSIGN;
                 move_forward();
             }
             return ret;
@@ -157,22 +321,20 @@ Token Lexer::next_comment() {
 
 Token Lexer::next_number() {
     Token ret(TT::NUMBER, "", row, col);
-    while (isdigit(c)) {
-        ret.value += c;
-        move_forward();
-    }
+    const char* start = pos;
+    skip_inline(scan.skip_digits(pos, end));
+    ret.value = std::string_view(start, pos - start);
     return ret;
 }
 
 Token Lexer::next_identifier() {
     Token ret(TT::IDENTIFIER, "", row, col);
-    while((isalnum(c) || c == '_') && !file.eof()) {
-        ret.value += c;
-        move_forward();
-    }
-    auto it = get_token_type.find(ret.value);
-    if (it != get_token_type.end()) {  // keyword
-        ret.type = it->second;
+    const char* start = pos;
+    skip_inline(scan.skip_ident(pos, end));
+    ret.value = std::string_view(start, pos - start);
+    ret.type = keyword_type(ret.value);  // keyword or identifier
+    if (ret.type == TT::OPERATOR) {
+        ret.op = OP::SIZEOF;             // the only keyword operator
     }
     return ret;
 }
@@ -180,12 +342,12 @@ Token Lexer::next_identifier() {
 Token Lexer::next_char() {
     Token ret(TT::CHAR, "", row, col);
     move_forward();
-    ret.value = c;
+    ret.value = std::string_view(pos, 1);
     if (c == '\\') {  // escape character
         move_forward();
-        auto it = get_escape_char.find(c);
-        if (it != get_escape_char.end()) {
-            ret.value = it->second;
+        int e = escape_char(c);
+        if (e != -1) {
+            ret.value = std::string_view(&byte_table[e], 1);
         } else {
             lexer_error(std::format("unknown escape sequence '\\{}'", c), row);
         }
@@ -198,86 +360,89 @@ Token Lexer::next_char() {
     return ret;
 }
 
+// The value is a view of the source unless the literal has escape sequences,
+// in which case it is decoded into the literal buffer.
 Token Lexer::next_string() {
     Token ret(TT::STRING, "", row, col);
     move_forward();
-    string s;
-    while (c != '"') {
-        if (c == '\\') {             // escape character
+    const char* start = pos;
+    bool decoded = false;
+    while (true) {
+        const char* q = scan.find_string_end(pos, end);  // plain characters up to q
+        if (decoded) {
+            scratch.append(pos, q);
+        }
+        skip_to(q);
+        if (c == '"') {
+            break;
+        } else if (c == '\0') {
+            lexer_error("missing terminating \" character", row);
+        }
+        // escape character
+        if (!decoded) {
+            scratch.assign(start, pos);
+            decoded = true;
+        }
+        move_forward();
+        if (c == '\0') {
+            lexer_error("missing terminating \" character", ret.row);
+        } else if (c == '\n') {  // line continuation
             move_forward();
-            if (file.eof()) {
-                lexer_error("missing terminating \" character", ret.row);
-            } else if (c == '\n') {  // line continuation
-                move_forward();
-                continue;
-            }
-            auto it = get_escape_char.find(c);
-            if (it != get_escape_char.end()) {
-                s += it->second;
-            } else {
-                lexer_error(std::format("unknown escape sequence '\\{}'", c), row);
-            }
+            continue;
+        }
+        int e = escape_char(c);
+        if (e != -1) {
+            scratch += static_cast<char>(e);
         } else {
-            s += c;
-        } 
-        move_forward();
-        if (file.eof()) {
-            lexer_error("missing terminating \" character", row);
+            lexer_error(std::format("unknown escape sequence '\\{}'", c), row);
         }
+        move_forward();
     }
-    ret.value = s;
+    ret.value = decoded ? literals.store(scratch) : std::string_view(start, pos - start);
     move_forward();
     return ret;
 }
 
+// Consume c if it is "next".
+bool Lexer::accept(char next) {
+    if (c == next) {
+        move_forward();
+        return true;
+    }
+    return false;
+}
+
 Token Lexer::next_symbol() {
-    Token ret(TT::OPERATOR, string{c}, row, col);
+    Token ret(TT::OPERATOR, "", row, col);
     // bool unary = true;
+    const char* start = pos;
     char first = c;
     move_forward();
     switch (first) {
         // operator
-        case '~':
-        case '.':
-        case '?':
-            break;
-        case '*':
-        case '%':
-        case '^':
-        case '!':
-        case '=':
-            if (c == '=') {
-                ret.value += c;
-                move_forward();
-            }
-            break;
-        case '+':
-        case '&':
-        case '|':
-            if (c == first || c == '=') {
-                ret.value += c;
-                move_forward();
-            }
-            break;
+        case '~': ret.op = OP::BIT_NOT; break;
+        case '.': ret.op = OP::DOT; break;
+        case '?': ret.op = OP::QUESTION; break;
+        case '*': ret.op = accept('=') ? OP::MUL_ASSIGN : OP::MUL; break;
+        case '%': ret.op = accept('=') ? OP::MOD_ASSIGN : OP::MOD; break;
+        case '^': ret.op = accept('=') ? OP::XOR_ASSIGN : OP::BIT_XOR; break;
+        case '!': ret.op = accept('=') ? OP::NE : OP::NOT; break;
+        case '=': ret.op = accept('=') ? OP::EQ : OP::ASSIGN; break;
+        case '+': ret.op = accept('+') ? OP::INC : accept('=') ? OP::ADD_ASSIGN : OP::ADD; break;
+        case '&': ret.op = accept('&') ? OP::AND : accept('=') ? OP::AND_ASSIGN : OP::BIT_AND; break;
+        case '|': ret.op = accept('|') ? OP::OR : accept('=') ? OP::OR_ASSIGN : OP::BIT_OR; break;
         case '-':
-            if (c == '-' || c == '=' || c == '>') {
-                ret.value += c;
-                move_forward();
-            }
+            ret.op = accept('-') ? OP::DEC
+                   : accept('=') ? OP::SUB_ASSIGN
+                   : accept('>') ? OP::ARROW : OP::SUB;
             break;
         case '<':
+            ret.op = accept('=') ? OP::LE
+                   : accept('<') ? (accept('=') ? OP::SHL_ASSIGN : OP::SHL) : OP::LT;
+            break;
         case '>':
-            if (c == '=') {
-                ret.value += c;
-                move_forward();
-            } else if (c == first) {
-                ret.value += c;
-                move_forward();
-                if (c == '=') {
-                    ret.value += c;
-                    move_forward();
-                }
-            }
+            ret.op = accept('=') ? OP::GE
+                   : accept('>') ? (accept('=') ? OP::SHR_ASSIGN : OP::SHR) : OP::GT;
             break;
         // symbol
         case '(': { ret.type = TT::L_PARENTHESIS; break; }
@@ -286,7 +451,7 @@ Token Lexer::next_symbol() {
         case ']': { ret.type = TT::R_BRACKET; break; }
         case '{': { ret.type = TT::L_BRACE; break; }
         case '}': { ret.type = TT::R_BRACE; break; }
-        case ',': { ret.type = TT::COMMA; break; }
+        case ',': { ret.type = TT::COMMA; ret.op = OP::COMMA; break; }
         case ';': { ret.type = TT::SEMICOLON; break; }
         case ':': { ret.type = TT::COLON; break; }
         case '#': { ret.type = TT::HASH; break; }
@@ -301,5 +466,6 @@ Token Lexer::next_symbol() {
         default:
             lexer_error(std::format("unknown symbol '{}'", first), ret.row);
     }
+    ret.value = std::string_view(start, pos - start);
     return ret;
-}
\ No newline at end of file
+}
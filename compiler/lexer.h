@@ -5,13 +5,19 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
+#include <cstdint>
 
 #include <unordered_map>
 #include <unordered_set>
 
 
 #include "error.h"
+#include "source.h"
+#include "scan.h"
+#include "output.h"
 
 // token type
 enum class TT {
@@ -58,13 +64,58 @@ enum class TT {
     COLON
 };
 
+// operator
+enum class OP : uint8_t {
+    NONE,
+    // arithmetic
+    ADD, SUB, MUL, DIV, MOD,
+    INC, DEC,
+    // bitwise
+    BIT_AND, BIT_OR, BIT_XOR, BIT_NOT, SHL, SHR,
+    // logical
+    AND, OR, NOT,
+    // relational
+    EQ, NE, LT, LE, GT, GE,
+    // assignment
+    ASSIGN, ADD_ASSIGN, SUB_ASSIGN, MUL_ASSIGN, DIV_ASSIGN, MOD_ASSIGN,
+    SHL_ASSIGN, SHR_ASSIGN, AND_ASSIGN, XOR_ASSIGN, OR_ASSIGN,
+    // else
+    COMMA, QUESTION, DOT, ARROW, SIZEOF,
+    COUNT
+};
+
+// Spelling of each operator, indexed by OP.
+constexpr std::string_view op_text[] = {
+    "",
+    "+", "-", "*", "/", "%",
+    "++", "--",
+    "&", "|", "^", "~", "<<", ">>",
+    "&&", "||", "!",
+    "==", "!=", "<", "<=", ">", ">=",
+    "=", "+=", "-=", "*=", "/=", "%=",
+    "<<=", ">>=", "&=", "^=", "|=",
+    ",", "?", ".", "->", "sizeof"
+};
+static_assert(std::size(op_text) == static_cast<size_t>(OP::COUNT));
+
+constexpr std::string_view op_name(OP op) { return op_text[static_cast<size_t>(op)]; }
+
+// Lets string-keyed hash tables be searched with a string_view.
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
 struct Token {
     TT type;
-    string value;
+    std::string_view value;  // points into the source, or into the literal buffer if decoded
     int row;
     int col;
-    void print();
-    bool is_specifier() {
+    OP op = OP::NONE;        // for TT::OPERATOR and TT::COMMA
+    size_t offset = 0;       // of the first character in the source
+    template <bool Color>
+    void print(Output& out) const;
+    bool is_specifier() const {
         return type == TT::STATIC
             || type == TT::EXTERN
             || type == TT::VOID
@@ -75,25 +126,71 @@ struct Token {
             || type == TT::DOUBLE
             || type == TT::STRUCT;
     }
-    bool is_operator(string s="") {
+    bool is_operator(OP o=OP::NONE) const {
         if (type == TT::OPERATOR || type == TT::COMMA) {
-            return s.empty() ? true : s == value;
+            return o == OP::NONE ? true : o == op;
         }
         return false;
     }
 };
 
+// Storage for decoded char and string literals.
+// Blocks never move, so the views handed out stay valid as long as the buffer lives.
+class LiteralBuffer {
+public:
+    std::string_view store(std::string_view s);
+    size_t allocations() const { return blocks.size(); }
+private:
+    static constexpr size_t BLOCK_SIZE = 1 << 16;
+    vector<std::unique_ptr<char[]>> blocks;
+    char* free = nullptr;
+    size_t left = 0;
+};
+
 class Lexer {
 public:
-    Lexer(string f, bool l);
+    Lexer(string f, bool l, Output& o = standard_output(), bool color = true);
+    Lexer(const char* buf, size_t len, bool l, Output& o = standard_output(), bool color = true);
     Token next();
+    // Print a token the way next() does, if tokens are printed.
+    void echo(const Token& t) {
+        if (lex_flag && t.type != TT::END) {
+            (t.*print_token)(out);
+        }
+    }
+    size_t count() const { return tokens; }
+    size_t allocations() const { return literals.allocations(); }
+    std::string_view text() const { return source.view(); }
+    size_t offset() const { return origin + (pos - source.begin()); }  // of the next character
+    int line() const { return row; }
+    // Count rows, columns and offsets from here, for a buffer that is a part of a larger source.
+    void set_position(int r, int c, size_t o = 0) {
+        row = r;
+        col = c;
+        origin = o;
+    }
+    bool skip_block();
 private:
-    std::ifstream file;
+    Source source;
+    const char* pos;      // position of c
+    const char* end;
     char c;               // currend character, i.e., the next character to be used
+                          // '\0' marks the end of the buffer
     int row = 0;          // current row
-    int col = -1;         // current column
+    int col = 0;          // current column
+    size_t origin = 0;    // offset of the buffer in the whole source
+    const char* token_start;  // of the token being lexed
     bool lex_flag;        // whether to print tokens
+    Output& out;
+    void (Token::*print_token)(Output&) const;  // colored or not, chosen once
+    size_t tokens = 0;    // number of tokens returned by next()
+    LiteralBuffer literals;
+    string scratch;       // reused when decoding string literals
+    const ScanKernels& scan = scan_kernels();
     void move_forward();
+    void skip_to(const char* q);
+    void skip_inline(const char* q);
+    bool accept(char next);
     Token next_token();
     Token next_identifier();
     Token next_number();
@@ -101,18 +198,30 @@ private:
     Token next_string();
     Token next_comment();
     Token next_symbol();
+    void start(bool color);
 };
 
-inline Lexer::Lexer(string f, bool l) : file(f), lex_flag(l) {
-    if (!file) {
-        cerr << COLOR_ERROR << "error: " << COLOR_RESET
-             << "failed to open the file" << endl;
-        exit(1);
-    }
+inline Lexer::Lexer(string f, bool l, Output& o, bool color) : source(f), lex_flag(l), out(o) {
+    start(color);
+}
+
+inline Lexer::Lexer(const char* buf, size_t len, bool l, Output& o, bool color)
+    : source(buf, len), lex_flag(l), out(o) {
+    start(color);
+}
+
+inline void Lexer::start(bool color) {
+    pos = source.begin();
+    end = source.end();
+    c = (pos != end) ? *pos : '\0';
+    print_token = color ? &Token::print<true> : &Token::print<false>;
     if (lex_flag) {
-        cout << COLOR_TITLE << "[ row: col] token" << COLOR_RESET << endl;
+        if (color) {
+            out << COLOR_TITLE << "[ row: col] token" << COLOR_RESET << '\n';
+        } else {
+            out << "[ row: col] token\n";
+        }
     }
-    move_forward();
 }
 
 #endif
\ No newline at end of file
@@ -1,26 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <new>
+#include <thread>
+
 #include "error.h"
-#include "lexer.h"
 #include "parser.h"
+#include "flat.h"
+#include "json.h"
+#include "pool.h"
+#include "driver.h"
+#include "serve.h"
+
+
+// Number of heap allocations made so far, reported by "--stats".
+std::atomic<size_t> heap_allocations = 0;
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Count the heap allocations of lexing alone and of lexing plus parsing.
+void print_stats(const string& file_name) {
+    Lexer lexer(file_name, false);
+    size_t before = heap_allocations;
+    while (lexer.next().type != TT::END) {}
+    size_t lexing = heap_allocations - before;
+    size_t tokens = lexer.count();
+
+    Lexer lexer2(file_name, false);
+    Parser parser(lexer2, false);
+    before = heap_allocations;
+    unique_ptr<Program> program = parser.program();
+    size_t parsing = heap_allocations - before;
+
+    double n = tokens ? tokens : 1;
+    cerr << std::format("tokens: {}\n", tokens)
+         << std::format("heap allocations while lexing: {} ({:.3f} per token)\n", lexing, lexing / n)
+         << std::format("heap allocations while parsing: {} ({:.3f} per token)\n", parsing, parsing / n)
+         << std::format("interned symbols: {}\n", program->symbols.size())
+         << std::format("AST arena: {} bytes used, {} bytes reserved\n",
+                        program->arena.used(), program->arena.reserved());
+    FlatAST flat = flatten(*program);
+    cerr << std::format("flat AST: {} nodes, {} bytes\n", flat.nodes.size(), flat.bytes());
+}
+
+// Expand an argument into input files:
+// a directory stands for the C sources below it, and "@list" for the arguments listed in it, one per line.
+void add_inputs(const string& arg, vector<string>& files) {
+    namespace fs = std::filesystem;
+    if (arg.starts_with('@')) {
+        std::ifstream list(arg.substr(1));
+        if (!list) {
+            cerr << COLOR_ERROR << "error: " << COLOR_RESET
+                 << "failed to open the file list " << arg.substr(1) << endl;
+            exit(1);
+        }
+        string line;
+        while (std::getline(list, line)) {
+            while (!line.empty() && isspace(static_cast<unsigned char>(line.back()))) {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                add_inputs(line, files);
+            }
+        }
+        return;
+    }
+    std::error_code ec;
+    if (!fs::is_directory(arg, ec)) {
+        files.push_back(arg);
+        return;
+    }
+    vector<string> found;
+    for (const auto& entry : fs::recursive_directory_iterator(arg, ec)) {
+        auto ext = entry.path().extension();
+        if (entry.is_regular_file(ec) && (ext == ".c" || ext == ".h")) {
+            found.push_back(entry.path().string());
+        }
+    }
+    std::sort(found.begin(), found.end());  // in a fixed order, whatever the file system says
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+// Heads the output of each file when there are several.
+// Binary ASTs need none, as each holds its own size.
+void print_file_name(Output& out, const string& file_name, const Options& options) {
+    if (options.emit == Emit::BINARY) {
+        return;
+    }
+    if (options.emit == Emit::JSON) {
+        JsonWriter json(out);
+        json.raw("{\"file\":");
+        json.string(file_name);
+        json.raw("}\n");
+    } else if (options.color) {
+        out << COLOR_TITLE << file_name << COLOR_RESET << '\n';
+    } else {
+        out << file_name << '\n';
+    }
+}
 
+// The outcome of one file, printed once all the files before it are done.
+struct Result {
+    string out;
+    string error;
+    bool failed = false;
+    bool done = false;
+};
+
+// Compile the files on a pool of workers and print the results in input order.
+// At most a few files per worker are in flight, so the output held back stays bounded however many files there are.
+// Returns whether all files compiled.
+bool compile_all(const vector<string>& files, const Options& options) {
+    vector<Result> results(files.size());
+    std::mutex lock;
+    std::condition_variable finished;
+    bool ok = true;
+    Pool pool(options.jobs);
+    auto submit = [&](size_t i) {
+        pool.submit([&, i] {
+            Result& r = results[i];
+            {
+                Output out(r.out);
+                try {
+                    compile(files[i], options, out);
+                } catch (const CompileError& e) {
+                    r.failed = true;
+                    r.error = error_text(e, options.color);
+                }
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                r.done = true;
+            }
+            finished.notify_all();
+        });
+    };
+    size_t window = std::max<size_t>(options.jobs, 1) * 4;
+    size_t submitted = std::min(window, files.size());
+    for (size_t i = 0; i != submitted; ++i) {
+        submit(i);
+    }
+    Output& out = standard_output();
+    for (size_t i = 0; i != files.size(); ++i) {
+        Result& r = results[i];
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            finished.wait(guard, [&] { return r.done; });
+        }
+        if (submitted != files.size()) {
+            submit(submitted++);
+        }
+        print_file_name(out, files[i], options);
+        out << r.out;
+        if (r.failed) {
+            out.flush();
+            cerr << files[i] << ": " << r.error;
+            ok = false;
+        }
+        string().swap(r.out);
+        string().swap(r.error);
+    }
+    return ok;
+}
 
 int main(int argc, char* argv[]) {
-    string file_name_with_dir;
-    bool lex_flag = false;
-    bool par_flag = true;
-    for (int i = 0; i < argc; ++i) {
-        string arg = argv[i];
-        if (arg == "--lex") {         // print tokens
-            lex_flag = true;
-            continue;
+    vector<string> files;
+    vector<string> args(argv + 1, argv + argc);
+    Options options;
+    string serve_path;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string& arg = args[i];
+        string error;
+        if (set_option(args, i, options, error)) {
+            if (!error.empty()) {
+                cerr << COLOR_ERROR << "error: " << COLOR_RESET << error << endl;
+                return 1;
+            }
+        } else if (arg == "--cache-dir") {  // keep parse results in a directory, reused while the files are the same
+            if (i + 1 < args.size()) {
+                options.cache_dir = args[++i];
+            }
+        } else if (arg == "--cache-size") {  // the most the cache directory may hold, in MB
+            if (i + 1 < args.size()) {
+                options.cache_size = static_cast<size_t>(atol(args[++i].c_str()));
+            }
+        } else if (arg == "--serve") {  // answer requests on a Unix domain socket, or on stdin/stdout for "-"
+            if (i + 1 < args.size()) {
+                serve_path = args[++i];
+            }
+        } else if (arg == "--stats") {  // print allocation counts
+            options.stats = true;
         // } else if (arg == "--par") {  // print the AST
-        //     par_flag = true;
-        //     continue;
+        //     options.parse = true;
+        } else if (arg.starts_with("-j")) {  // number of worker threads, "-j N" or "-jN"; 0 for one per core
+            string n = arg.size() > 2 ? arg.substr(2) : (i + 1 < args.size() ? args[++i] : "");
+            options.jobs = static_cast<unsigned>(atoi(n.c_str()));
+            if (options.jobs == 0) {
+                options.jobs = std::max(std::thread::hardware_concurrency(), 1u);
+            }
         } else {
-            file_name_with_dir = arg;
+            add_inputs(arg, files);
+        }
+    }
+    if (!serve_path.empty()) {
+        return serve(serve_path) ? 0 : 1;
+    }
+    if (files.empty()) {
+        cerr << COLOR_ERROR << "error: " << COLOR_RESET << "no input files" << endl;
+        return 1;
+    }
+    std::optional<Cache> cache;
+    if (!options.cache_dir.empty()) {
+        cache.emplace(options.cache_dir, options.cache_size << 20);
+        options.cache = &*cache;
+    }
+    if (options.stats) {
+        for (const string& file : files) {
+            try {
+                print_stats(file);
+            } catch (const CompileError&) {
+                // reported when compiling below
+            }
+        }
+    }
+    if (files.size() > 1 && options.jobs > 1 && !options.parallel) {
+        return compile_all(files, options) ? 0 : 1;
+    }
+    bool ok = true;
+    for (const string& file : files) {
+        Output& out = standard_output();
+        if (files.size() > 1) {
+            print_file_name(out, file, options);
+        }
+        try {
+            compile(file, options, out);
+        } catch (const CompileError& e) {
+            out.flush();
+            cerr << (files.size() > 1 ? file + ": " : "") << error_text(e, options.color);
+            ok = false;
         }
     }
-    Lexer lexer(file_name_with_dir, lex_flag);
-    Parser parser(lexer, par_flag);
-    parser.program();
-    return 0;
-}
\ No newline at end of file
+    return ok ? 0 : 1;
+}
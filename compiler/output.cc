@@ -0,0 +1,27 @@
+#include <cerrno>
+#include <unistd.h>
+
+#include "output.h"
+
+void Output::write_all(const char* p, size_t n) {
+    if (sink) {
+        sink->append(p, n);
+        return;
+    }
+    while (n != 0) {
+        ssize_t k = write(fd, p, n);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;  // nothing sensible to do, e.g., the reader has gone away
+        }
+        p += k;
+        n -= k;
+    }
+}
+
+Output& standard_output() {
+    static Output out(STDOUT_FILENO);
+    return out;
+}
@@ -0,0 +1,75 @@
+#ifndef HEADER_OUTPUT
+#define HEADER_OUTPUT
+
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Buffered output to a file descriptor.
+// Everything is collected in one large buffer and written with a single write(2) whenever it fills up,
+// so printing costs a memcpy per piece instead of a stream operation (and no flush per line).
+class Output {
+public:
+    explicit Output(int f) : fd(f), capacity(1 << 20), buf(std::make_unique_for_overwrite<char[]>(capacity)) {}
+    // Collect the output in "s" instead, e.g., to print the results of parallel work in order later.
+    explicit Output(std::string& s) : sink(&s), capacity(1 << 16), buf(std::make_unique_for_overwrite<char[]>(capacity)) {}
+    Output(const Output&) = delete;
+    Output& operator=(const Output&) = delete;
+    ~Output() { flush(); }
+
+    Output& operator<<(std::string_view s) {
+        if (s.size() > capacity - used) {
+            flush();
+            if (s.size() > capacity) {
+                write_all(s.data(), s.size());
+                return *this;
+            }
+        }
+        std::memcpy(buf.get() + used, s.data(), s.size());
+        used += s.size();
+        return *this;
+    }
+    Output& operator<<(char c) {
+        if (used == capacity) {
+            flush();
+        }
+        buf[used++] = c;
+        return *this;
+    }
+    template <std::integral T>
+    Output& operator<<(T v) {
+        char tmp[24];
+        auto [end, ec] = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        return *this << std::string_view(tmp, end - tmp);
+    }
+    // "v" right-aligned in "width" columns, like std::format("{:>width}", v).
+    Output& pad(long v, size_t width) {
+        char tmp[24];
+        auto [end, ec] = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        size_t n = end - tmp;
+        for (; n < width; ++n) {
+            *this << ' ';
+        }
+        return *this << std::string_view(tmp, end - tmp);
+    }
+    void flush() {
+        write_all(buf.get(), used);
+        used = 0;
+    }
+
+private:
+    int fd = -1;
+    std::string* sink = nullptr;
+    size_t capacity;
+    std::unique_ptr<char[]> buf;
+    size_t used = 0;
+    void write_all(const char* p, size_t n);
+};
+
+// Buffered standard output, flushed at exit.
+Output& standard_output();
+
+#endif
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "parallel.h"
+#include "parser.h"
+#include "pool.h"
+
+vector<size_t> split_declarations(const vector<Token>& tokens) {
+    vector<size_t> ret = {0};
+    int depth = 0;             // of braces
+    bool initializer = false;  // whether the outermost braces are an initializer list, not a body
+    for (size_t i = 0; i != tokens.size(); ++i) {
+        switch (tokens[i].type) {
+            case TT::L_BRACE:
+                if (depth++ == 0) {
+                    initializer = i != ret.back() && tokens[i - 1].is_operator(OP::ASSIGN);
+                }
+                break;
+            case TT::R_BRACE:
+                if (depth > 0 && --depth == 0 && !initializer) {
+                    ret.push_back(i + 1);
+                }
+                break;
+            case TT::SEMICOLON:
+                if (depth == 0) {
+                    ret.push_back(i + 1);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (ret.back() != tokens.size()) {
+        ret.push_back(tokens.size());  // the last declaration is cut short
+    }
+    return ret;
+}
+
+// A part of the source lexed on its own, from the start of a line.
+struct Chunk {
+    const char* begin;
+    const char* end;
+    size_t lines = 0;  // newlines in [begin, end)
+    size_t base = 0;   // newlines before begin, i.e., the row of begin
+};
+
+// The tokens lexed from some place in a chunk, supposing the lexer is in a certain state there.
+struct Run {
+    unique_ptr<Lexer> lexer;
+    vector<Token> tokens;               // those starting in the chunk, with rows counted from it
+    Token next;                         // the token right after them
+    std::optional<CompileError> error;  // with the line counted from the chunk, too
+};
+
+// Lex from p, at (row, col) of the chunk and "origin" of the file, until a token starts after its "lines" lines.
+static void lex_run(Run& run, const char* p, const char* end, int row, int col, size_t origin, size_t lines) {
+    run.lexer = make_unique<Lexer>(p, end - p, false);
+    run.lexer->set_position(row, col, origin);
+    try {
+        while (true) {
+            Token t = run.lexer->next();
+            if (t.type == TT::END || static_cast<size_t>(t.row) >= lines) {
+                run.next = t;
+                return;
+            }
+            run.tokens.push_back(t);
+        }
+    } catch (const CompileError& e) {
+        run.error = e;
+    }
+}
+
+LexedFile lex_in_parallel(Lexer& lexer, unsigned jobs) {
+    static constexpr size_t MIN_CHUNK = 1 << 18;  // bytes
+    LexedFile ret;
+    std::string_view text = lexer.text();
+    const char* stop = text.data() + text.size();
+    vector<const char*> begins = {text.data()};
+    size_t count = std::min<size_t>(jobs, text.size() / MIN_CHUNK);
+    for (size_t i = 1; i < count; ++i) {
+        const char* p = text.data() + text.size() / count * i;
+        p = static_cast<const char*>(memchr(p, '\n', stop - p));
+        if (p && p + 1 != stop && p + 1 > begins.back()) {
+            begins.push_back(p + 1);
+        }
+    }
+    if (begins.size() == 1) {
+        // too small to be worth it
+        try {
+            for (Token t = lexer.next(); ; t = lexer.next()) {
+                if (t.type == TT::END) {
+                    ret.end = t;
+                    break;
+                }
+                ret.tokens.push_back(t);
+            }
+        } catch (const CompileError& e) {
+            ret.error = e;
+        }
+        return ret;
+    }
+
+    const ScanKernels& scan = scan_kernels();
+    vector<Chunk> chunks;
+    for (size_t i = 0; i != begins.size(); ++i) {
+        Chunk c{begins[i], i + 1 != begins.size() ? begins[i + 1] : stop};
+        c.lines = scan.count_lines(c.begin, c.end).count;
+        c.base = i ? chunks.back().base + chunks.back().lines : 0;
+        chunks.push_back(c);
+    }
+    // runs[i][0] supposes the lexer is between tokens at the start of chunk i, runs[i][1] in a comment
+    vector<std::array<Run, 2>> runs(chunks.size());
+    {
+        Pool pool(jobs);
+        for (size_t i = 0; i != chunks.size(); ++i) {
+            const Chunk& c = chunks[i];
+            pool.submit([&, i] { lex_run(runs[i][0], c.begin, stop, 0, 0, c.begin - text.data(), c.lines); });
+            if (i == 0) {
+                continue;  // the file starts in code
+            }
+            // The first "*/" ends the comment, if there is one.
+            const char* q = scan.find_comment_end(c.begin, c.end);
+            if (q != c.end && *q == '/') {
+                ++q;
+                Lines lines = scan.count_lines(c.begin, q);
+                int row = static_cast<int>(lines.count);
+                int col = static_cast<int>(q - (lines.count ? lines.last : c.begin));
+                pool.submit([&, i, q, row, col] {
+                    lex_run(runs[i][1], q, stop, row, col, q - text.data(), c.lines);
+                });
+            }
+        }
+    }
+
+    // Chunk 0 is lexed right. From the token after it, look for a run of the chunk where that token is,
+    // which also has it: the run is right from there on.
+    vector<Run> again;  // lexed sequentially, if no run has the token
+    again.reserve(chunks.size());
+    size_t k = 0;
+    const Run* run = &runs[0][0];
+    size_t from = 0;
+    while (true) {
+        int base = static_cast<int>(chunks[k].base);
+        for (size_t i = from; i != run->tokens.size(); ++i) {
+            Token t = run->tokens[i];
+            t.row += base;
+            lexer.echo(t);
+            ret.tokens.push_back(t);
+        }
+        if (run->error) {
+            ret.error = *run->error;
+            ret.error->line += base;
+            break;
+        }
+        Token next = run->next;
+        next.row += base;
+        if (next.type == TT::END) {
+            ret.end = next;
+            break;
+        }
+        while (k + 1 != chunks.size() && static_cast<size_t>(next.row) >= chunks[k + 1].base) {
+            ++k;
+        }
+        Token at = next;  // where it is in the chunk
+        at.row -= static_cast<int>(chunks[k].base);
+        auto before = [](const Token& a, const Token& b) {
+            return a.row != b.row ? a.row < b.row : a.col < b.col;
+        };
+        run = nullptr;
+        for (const Run& r : runs[k]) {
+            auto it = std::lower_bound(r.tokens.begin(), r.tokens.end(), at, before);
+            if (it != r.tokens.end() && it->row == at.row && it->col == at.col) {
+                run = &r;
+                from = it - r.tokens.begin();
+                break;
+            }
+        }
+        if (!run) {
+            const char* p = chunks[k].begin;
+            for (int i = 0; i != at.row; ++i) {
+                p = static_cast<const char*>(memchr(p, '\n', stop - p)) + 1;
+            }
+            again.emplace_back();
+            lex_run(again.back(), p + at.col, stop, at.row, at.col, p + at.col - text.data(), chunks[k].lines);
+            run = &again.back();
+            from = 0;
+        }
+    }
+    for (auto& chunk_runs : runs) {
+        for (Run& r : chunk_runs) {
+            if (r.lexer) {
+                ret.lexers.push_back(std::move(r.lexer));
+            }
+        }
+    }
+    for (Run& r : again) {
+        ret.lexers.push_back(std::move(r.lexer));
+    }
+    return ret;
+}
+
+// Consecutive declarations parsed by one task.
+struct Part {
+    Arena arena;
+    vector<AST*> decls;
+    vector<SourceRange> spans;
+    std::optional<CompileError> error;
+};
+
+unique_ptr<Program> parse_in_parallel(Lexer& lexer, unsigned jobs, const TreeOptions& tree) {
+    // In case of a lexing error, the tokens before it are still parsed,
+    // since a parser error among them comes first.
+    LexedFile lexed = lex_in_parallel(lexer, jobs);
+    const vector<Token>& tokens = lexed.tokens;
+    const Token& end = lexed.end;
+    const std::optional<CompileError>& lexing_error = lexed.error;
+
+    // Identifiers are interned here, so the workers share nothing mutable.
+    unique_ptr<Program> ret = make_unique<Program>();
+    vector<Symbol> names(tokens.size());
+    for (size_t i = 0; i != tokens.size(); ++i) {
+        if (tokens[i].type == TT::IDENTIFIER) {
+            names[i] = ret->symbols.intern(tokens[i].value);
+        }
+    }
+
+    // A few parts per thread, each of whole declarations, to even out the load.
+    static constexpr size_t MIN_PART = 1 << 12;  // tokens
+    vector<size_t> starts = split_declarations(tokens);
+    size_t target = std::max(tokens.size() / (std::max(jobs, 1u) * 8), MIN_PART);
+    vector<size_t> bounds = {0};  // the first declaration of each part, then the number of declarations
+    for (size_t d = 1; d < starts.size(); ++d) {
+        if (starts[d] - starts[bounds.back()] >= target || d + 1 == starts.size()) {
+            bounds.push_back(d);
+        }
+    }
+    if (bounds.size() == 1 && lexing_error) {
+        throw *lexing_error;
+    }
+
+    vector<Part> parts(bounds.size() - 1);
+    {
+        Pool pool(jobs);
+        for (size_t p = 0; p != parts.size(); ++p) {
+            pool.submit([&, p] {
+                size_t first = starts[bounds[p]];
+                size_t last = starts[bounds[p + 1]];
+                TokenSpan span{tokens.data() + first, tokens.data() + first, tokens.data() + last,
+                               names.data() + first, end, nullptr};
+                if (last != tokens.size()) {
+                    span.last = Token{TT::END, "", tokens[last].row, tokens[last].col, OP::NONE, tokens[last].offset};
+                } else if (lexing_error) {
+                    span.error = &*lexing_error;
+                }
+                try {
+                    Parser parser(span, false);
+                    parser.configure(tree);
+                    parser.declarations(parts[p].arena, parts[p].decls, parts[p].spans);
+                } catch (const CompileError& e) {
+                    parts[p].error = e;
+                }
+            });
+        }
+    }  // waits for all parts
+
+    for (Part& part : parts) {
+        if (part.error) {
+            throw *part.error;
+        }
+        ret->decls.insert(ret->decls.end(), part.decls.begin(), part.decls.end());
+        ret->spans.insert(ret->spans.end(), part.spans.begin(), part.spans.end());
+        ret->owners.resize(ret->decls.size(), static_cast<uint32_t>(ret->parts.size()));
+        ret->parts.push_back(std::move(part.arena));
+    }
+    return ret;
+}
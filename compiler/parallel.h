@@ -0,0 +1,36 @@
+#ifndef HEADER_PARALLEL
+#define HEADER_PARALLEL
+
+#include <optional>
+
+#include "lexer.h"
+#include "AST.h"
+#include "parser.h"
+
+// The tokens of a whole file, up to END or the first lexing error.
+struct LexedFile {
+    vector<Token> tokens;
+    Token end;                          // END, if there was no error
+    std::optional<CompileError> error;  // the first lexing error, right after the tokens
+    vector<unique_ptr<Lexer>> lexers;   // own the decoded literals the tokens point to
+};
+
+// Lex the source of "lexer" in chunks on "jobs" threads, with the same tokens as calling lexer.next().
+// Each chunk starts at a line, and is lexed speculatively both as if it started in code and
+// as if it started inside a block comment. The chunks are stitched together at the first token
+// where the one known to be right meets a speculation, i.e., the same row and column;
+// the rest is lexed again sequentially if no speculation gets there.
+// Tokens are printed through "lexer" if it prints them.
+LexedFile lex_in_parallel(Lexer& lexer, unsigned jobs);
+
+// Where the top-level declarations start: the index of the first token of each,
+// then the number of tokens.
+// Braces are matched on tokens, so those inside strings, chars and comments never count.
+// A declaration ends with a ";" or, for a function, with the "}" closing its body.
+vector<size_t> split_declarations(const vector<Token>& tokens);
+
+// Lex the whole file in parallel, then parse its top-level declarations on "jobs" threads.
+// The result, and the first error in source order, are the same as for Parser::program().
+unique_ptr<Program> parse_in_parallel(Lexer& lexer, unsigned jobs, const TreeOptions& tree);
+
+#endif
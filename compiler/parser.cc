@@ -1,3 +1,5 @@
+#include <array>
+#include <charconv>
 
 #include "error.h"
 #include "parser.h"
@@ -33,20 +35,63 @@ void Parser::match(TT t) {
 // program ::= {<global-declaration>}
 unique_ptr<Program> Parser::program() {
     unique_ptr<Program> ret = make_unique<Program>();
-    while (token.type != TT::END) {
-        *ret += declaration(true);
+    if (!par_flag) {
+        symbols = &ret->symbols;
+        declarations(ret->arena, ret->decls, ret->spans);
+        return ret;
     }
-    if (par_flag) {
-        cout << COLOR_TITLE << "AST" << COLOR_RESET << endl;
-        ret->print(true);
+    // Each declaration is printed once parsed, so the output starts at once.
+    DeclarationPrinter printer(out, color, ret->symbols);
+    stream(*ret, [&](AST* decl, const SourceRange&) {
+        printer.print(decl, done());
+        return true;
+    });
+    return ret;
+}
+
+void Parser::declarations(Arena& a, vector<AST*>& decls, vector<SourceRange>& spans) {
+    arena = &a;
+    while (token.type != TT::END) {
+        SourceRange span{token.offset, 0, token.row, token.col};
+        decls.push_back(declaration(true));
+        span.length = token.offset - span.offset;
+        spans.push_back(span);
     }
+}
+
+AST* Parser::next_declaration(Program& program, SourceRange& span) {
+    arena = &program.arena;
+    symbols = &program.symbols;
+    span = {token.offset, 0, token.row, token.col};
+    AST* ret = declaration(true);
+    span.length = token.offset - span.offset;
     return ret;
 }
 
+void Parser::stream(Program& program, const std::function<bool(AST*, const SourceRange&)>& each) {
+    while (!done()) {
+        Arena::Mark mark = program.arena.mark();
+        SourceRange span;
+        AST* decl;
+        try {
+            decl = next_declaration(program, span);
+        } catch (const CompileError&) {
+            program.arena.rewind(mark);  // the part parsed before the error
+            throw;
+        }
+        if (each(decl, span)) {
+            program.decls.push_back(decl);
+            program.spans.push_back(span);
+        } else {
+            program.arena.rewind(mark);
+        }
+    }
+}
+
 // <global-declaration> ::= <variable-declaration> | <function-declaration>
 // <variable-declaration> ::= <specifier> <declarator> [ "=" <initializer> ] ";"
 // <function-declaration> ::= <specifier> <declarator> ( <block> | ";" )
-unique_ptr<AST> Parser::declaration(bool global) {
+AST* Parser::declaration(bool global) {
     if (token.type == TT::STRUCT) {
         // return struct_declaration();
     }
@@ -54,8 +99,8 @@ unique_ptr<AST> Parser::declaration(bool global) {
     Declarator decl = declarator();
     if (decl.parameters.empty()) {
         // variable declaration
-        unique_ptr<Variable> ret = make_unique<Variable>(type, std::move(decl));
-        if (token.is_operator("=")) {
+        Variable* ret = arena->make<Variable>(type, decl);
+        if (token.is_operator(OP::ASSIGN)) {
             consume();  // "="
             ret->init(initializer());
         }
@@ -63,7 +108,11 @@ unique_ptr<AST> Parser::declaration(bool global) {
         return ret;
     } else if (global) {
         // function declaration
-        unique_ptr<Function> ret = make_unique<Function>(type, std::move(decl));
+        Function* ret = arena->make<Function>(type, decl);
+        if (lazy && lexer && token.type == TT::L_BRACE) {
+            ret->deferred = skip_body();
+            return ret;
+        }
         switch(consume().type) {
             case TT::L_BRACE:
                 ret->body = block();
@@ -79,6 +128,39 @@ unique_ptr<AST> Parser::declaration(bool global) {
     return nullptr;
 }
 
+// Skip a function body at the byte level, with the current token being its "{".
+SourceRange Parser::skip_body() {
+    SourceRange ret;
+    ret.offset = token.offset;
+    ret.row = token.row;
+    ret.col = token.col;
+    if (!lexer->skip_block()) {
+        parser_error("expected '}'", lexer->line());
+    }
+    ret.length = lexer->offset() - ret.offset;
+    token = lexer->next();
+    return ret;
+}
+
+Block* Parser::function_body(Program& program) {
+    arena = &program.arena;
+    symbols = &program.symbols;
+    match(TT::L_BRACE);
+    return block();
+}
+
+void expand(Program& program, Function* function, std::string_view text, const TreeOptions& tree) {
+    if (function->body || function->deferred.length == 0) {
+        return;
+    }
+    const SourceRange& range = function->deferred;
+    Lexer lexer(text.data() + range.offset, range.length, false);
+    lexer.set_position(range.row, range.col, range.offset);
+    Parser parser(lexer, false);
+    parser.configure(tree);
+    function->body = parser.function_body(program);
+}
+
 // <specifier> ::= <type-specifier> | "static" | "extern"
 CType Parser::specifier(bool global) {
     CS storage_class = CS::NONE;
@@ -128,45 +210,66 @@ CType Parser::type_specifier() {
 // <direct-declarator> ::= <simple-declarator> [ <declarator-suffix> ]
 // <simple-declarator> ::= <identifier> | "(" <declarator> ")"
 // <declarator-suffix> ::= <parameter-list> | { "[" <const> "]" }+
+// Parsed in a loop: the stars and parentheses before the name are counted, the pointer depth being the
+// number of stars, and after the name each ")" is matched in turn, followed by the suffix of its level.
 Declarator Parser::declarator() {
-    Declarator ret;
-    if (is_operator("*")) {
-        consume();
-        ret = declarator();
-        ++ret.depth;
-        return ret;
+    int depth = 0;
+    int parentheses = 0;
+    while (true) {
+        if (is_operator(OP::MUL)) {
+            consume();  // "*"
+            ++depth;
+        } else if (token.type == TT::L_PARENTHESIS) {
+            consume();  // "("
+            nest();
+            ++parentheses;
+        } else {
+            break;
+        }
     }
-    // simple declarator
-    if (token.type == TT::L_PARENTHESIS) {
-        ret = declarator();
+    Declarator ret(identifier());
+    ret.depth = depth;
+    declarator_suffix(ret);
+    for (; parentheses != 0; --parentheses) {
         match(TT::R_PARENTHESIS);
-    } else {
-        ret = Declarator(identifier());
+        unnest();
+        declarator_suffix(ret);
     }
-    // declarator suffix
+    return ret;
+}
+
+void Parser::declarator_suffix(Declarator& d) {
     if (token.type == TT::L_PARENTHESIS) {
         // parameter list
         consume();  // "("
-        ret.parameters = parameter_list();
-    } else {
+        nest();
+        if (++parameter_nesting > MAX_PARAMETER_NESTING) {
+            parser_error(std::format("parameter lists nested too deeply (the limit is {})", MAX_PARAMETER_NESTING),
+                         token.row);
+        }
+        d.parameters = parameter_list();
+        --parameter_nesting;
+        unnest();
+    } else if (token.type == TT::L_BRACKET) {
+        size_t mark = scratch.size();
         while (token.type == TT::L_BRACKET) {
             consume();  // "["
-            ret.indexes.push_back(expression());
+            scratch.push_back(expression());
             match(TT::R_BRACKET);
         }
+        d.indexes = collect<Expression>(mark);
     }
-    return ret;
 }
 
 // <parameter-list> ::= "(" "void" ")" | "(" <parameter> { "," <parameter> } ")"
-vector<Parameter> Parser::parameter_list() {
-    vector<Parameter> ret;
+List<Parameter> Parser::parameter_list() {
+    size_t mark = scratch_params.size();
     if (token.type == TT::VOID) {
-        ret.push_back(Parameter());
+        scratch_params.push_back(Parameter());
         consume();  // "void"
     } else {
         while (true) {
-            ret.push_back(parameter());
+            scratch_params.push_back(parameter());
             if (token.type == TT::COMMA) {
                 consume();  // ","
             } else {
@@ -175,6 +278,8 @@ vector<Parameter> Parser::parameter_list() {
         }
     }
     match(TT::R_PARENTHESIS);
+    List<Parameter> ret = arena->list<Parameter>(scratch_params.begin() + mark, scratch_params.end());
+    scratch_params.resize(mark);
     return ret;
 }
 
@@ -182,25 +287,52 @@ vector<Parameter> Parser::parameter_list() {
 Parameter Parser::parameter() {
     CType t = type_specifier();
     Declarator d = Declarator(declarator());
-    return Parameter(t, std::move(d));
+    return Parameter(t, d);
 }
 
 // <initializer> ::= <exp> | "{" [ <initializer-list> ] "}"
 // <initializer-list> ::= <initializer> { "," <initializer> } [ "," ]
-unique_ptr<Initializer> Parser::initializer() {
-    if (token.type == TT::L_BRACE) {
-        unique_ptr<Initializer> ret = make_unique<Initializer>();
-        do {
-            consume();  // "," or begining "{"
-            if (token.type == TT::R_BRACE) {
-                break;
+// Nested lists are kept on open_lists rather than parsed by recursion.
+Initializer* Parser::initializer() {
+    if (token.type != TT::L_BRACE) {
+        return arena->make<Initializer>(expression(2));
+    }
+    size_t base = open_lists.size();
+    while (true) {
+        // at the start of an item
+        Initializer* item = nullptr;
+        if (token.type == TT::L_BRACE) {
+            consume();  // "{"
+            nest();
+            open_lists.push_back({arena->make<Initializer>(), scratch.size()});
+            if (token.type != TT::R_BRACE) {
+                continue;
             }
-            *ret += initializer();
-        } while (token.type == TT::COMMA);
-        match(TT::R_BRACE);
-        return ret;
+        } else {
+            item = arena->make<Initializer>(expression(2));
+        }
+        // after an item, or at the "}" of an empty list
+        while (true) {
+            if (item) {
+                scratch.push_back(item);
+                if (token.type == TT::COMMA) {
+                    consume();  // ","
+                    if (token.type != TT::R_BRACE) {
+                        break;
+                    }
+                }
+            }
+            match(TT::R_BRACE);
+            unnest();
+            auto [list, mark] = open_lists.back();
+            open_lists.pop_back();
+            list->init_list = collect<Initializer>(mark);
+            if (open_lists.size() == base) {
+                return list;
+            }
+            item = list;
+        }
     }
-    return make_unique<Initializer>(expression(2));
 }
 
 // <statement> ::= ";"
@@ -213,47 +345,60 @@ unique_ptr<Initializer> Parser::initializer() {
 //               | "break" ";"
 //               | <block>
 //               | <exp> ";"
-unique_ptr<Statement> Parser::statement() {
-    unique_ptr<Statement> ret;
+// Statements that contain others are opened on open_statements and completed when their last part is
+// parsed, so else-if chains and nested blocks take no call stack.
+Statement* Parser::statement() {
+    size_t base = open_statements.size();
+    return statements(base, open_statement());
+}
+
+// <block> ::= "{" { <block-item> } "}"
+// <block-item> ::= <statement> | <declaration>
+// With the "{" consumed.
+Block* Parser::block() {
+    size_t base = open_statements.size();
+    open_block();
+    return static_cast<Block*>(statements(base, nullptr));
+}
+
+void Parser::open_block() {
+    nest();
+    open_statements.push_back({arena->make<Block>(), scratch.size()});
+}
+
+// Parse a statement that is complete at once, or open one that contains others and return nullptr.
+Statement* Parser::open_statement() {
     if (token.type == TT::SEMICOLON) {
         consume();  // ";"
-        return make_unique<Statement>();
+        return arena->make<Statement>();
     } else if (token.type == TT::RETURN) {
         consume();  // "return"
-        unique_ptr<Expression> ans = expression();
-        unique_ptr<Statement> ret = make_unique<ReturnStatement>(std::move(ans));
+        Expression* ans = expression();
+        Statement* ret = arena->make<ReturnStatement>(ans);
         match(TT::SEMICOLON);
         return ret;
     } else if (token.type == TT::IF) {
         consume();  // "if"
         match(TT::L_PARENTHESIS);
-        unique_ptr<Expression> cond = expression();
+        Expression* cond = expression();
         match(TT::R_PARENTHESIS);
-        unique_ptr<IfStatement> ret = make_unique<IfStatement>(std::move(cond), statement());
-        if (token.type == TT::ELSE) {
-            consume();  // "else"
-            ret->_else = statement();
-        }
-        return ret;
+        open_statements.push_back({arena->make<IfStatement>(cond, nullptr), 0});
+        return nullptr;
     } else if (token.type == TT::WHILE) {
         consume();  // "while"
         match(TT::L_PARENTHESIS);
-        unique_ptr<Expression> cond = expression();
+        Expression* cond = expression();
         match(TT::R_PARENTHESIS);
-        return make_unique<WhileStatement>(std::move(cond), statement());
+        open_statements.push_back({arena->make<WhileStatement>(cond, nullptr), 0});
+        return nullptr;
     } else if (token.type == TT::DO) {
         consume();  // "do"
-        unique_ptr<Statement> stmt = statement();
-        match(TT::WHILE);
-        match(TT::L_PARENTHESIS);
-        unique_ptr<Expression> cond = expression();
-        match(TT::R_PARENTHESIS);
-        match(TT::SEMICOLON);
-        return make_unique<DoStatement>(std::move(stmt), std::move(cond));
+        open_statements.push_back({arena->make<DoStatement>(nullptr, nullptr), 0});
+        return nullptr;
     } else if (token.type == TT::FOR) {
         consume();  // "for"
         match(TT::L_PARENTHESIS);
-        unique_ptr<ForStatement> ret = make_unique<ForStatement>();
+        ForStatement* ret = arena->make<ForStatement>();
         if (is_specifier()) {
             ret->init = declaration(false);
         } else {
@@ -270,133 +415,255 @@ unique_ptr<Statement> Parser::statement() {
             ret->inc = expression();
         }
         match(TT::R_PARENTHESIS);
-        ret->body = statement();
-        return ret;
+        open_statements.push_back({ret, 0});
+        return nullptr;
     } else if (token.type == TT::CONTINUE) {
         consume();  // "continue"
         match(TT::SEMICOLON);
-        return make_unique<ContinueStatement>();
+        return arena->make<ContinueStatement>();
     } else if (token.type == TT::BREAK) {
         consume();  // "break"
         match(TT::SEMICOLON);
-        return make_unique<BreakStatement>();
+        return arena->make<BreakStatement>();
     } else if (token.type == TT::L_BRACE) {
         consume();  // "{"
-        return block();
+        open_block();
+        return nullptr;
     } else {
-        unique_ptr<ExpStatement> ret = make_unique<ExpStatement>(expression());
+        ExpStatement* ret = arena->make<ExpStatement>(expression());
         match(TT::SEMICOLON);
         return ret;
     }
-    return nullptr;
 }
 
-// <block> ::= "{" { <block-item> } "}"
-// <block-item> ::= <statement> | <declaration>
-unique_ptr<Block> Parser::block() {
-    unique_ptr<Block> ret = make_unique<Block>();
-    while (token.type != TT::R_BRACE) {
-        int line = token.row;
-        if (is_specifier()) {
-            *ret += declaration(false);
-        } else {
-            *ret += statement();
+// Parse until the statements opened above "base" are complete, "done" being the one just parsed, if any,
+// and return the outermost of them.
+Statement* Parser::statements(size_t base, Statement* done) {
+    while (true) {
+        if (!done) {
+            // the innermost open statement asks for its next part
+            OpenStatement& top = open_statements.back();
+            if (top.node->kind != NK::BLOCK) {
+                done = open_statement();
+            } else if (token.type == TT::R_BRACE) {
+                consume();  // "}"
+                unnest();
+                static_cast<Block*>(top.node)->items = collect<AST>(top.mark);
+                done = top.node;
+                open_statements.pop_back();
+            } else if (is_specifier()) {
+                scratch.push_back(declaration(false));
+            } else {
+                done = open_statement();
+            }
+            continue;
+        }
+        if (open_statements.size() == base) {
+            return done;
+        }
+        // hand it to the innermost open statement
+        OpenStatement& top = open_statements.back();
+        switch (top.node->kind) {
+            case NK::BLOCK:
+                scratch.push_back(done);
+                done = nullptr;
+                continue;
+            case NK::IF: {
+                auto s = static_cast<IfStatement*>(top.node);
+                if (!s->then) {
+                    s->then = done;
+                    if (token.type == TT::ELSE) {
+                        consume();  // "else"
+                        done = nullptr;
+                        continue;
+                    }
+                } else {
+                    s->_else = done;
+                }
+                break;
+            }
+            case NK::WHILE:
+                static_cast<WhileStatement*>(top.node)->body = done;
+                break;
+            case NK::DO: {
+                auto s = static_cast<DoStatement*>(top.node);
+                s->body = done;
+                match(TT::WHILE);
+                match(TT::L_PARENTHESIS);
+                s->cond = expression();
+                match(TT::R_PARENTHESIS);
+                match(TT::SEMICOLON);
+                break;
+            }
+            case NK::FOR:
+                static_cast<ForStatement*>(top.node)->body = done;
+                break;
+            default:
+                break;
         }
+        done = top.node;
+        open_statements.pop_back();
     }
-    match(TT::R_BRACE);
-    return ret;
 }
 
 // expression
-std::unordered_set<string> unop = { 
-    "++", "--", "+", "-", "!", "~", "*", "&", "sizeof"
-};
-
-std::unordered_set<string> binop = { 
-    "+", "-", "*", "/", "%",
-    "&", "^", "|", "&&", "||", "<<", ">>",
-    "==", "!=", "<", "<=", ">", ">=", 
-    "=", "+=", "-=", "*=", "/=", "*=", "<<=", ">>=", "&=", "^=", "|=",
-    ",", "?"
+struct OpInfo {
+    bool unary = false;
+    bool binary = false;
+    int prec = 0;        // precedence as a binary operator
+    int assoc_left = 0;  // 1 if left-associative
 };
 
-bool Parser::is_unary() {
-    return token.is_operator() && (unop.find(token.value) != unop.end());
-}
-
-bool Parser::is_binary() {
-    return token.is_operator() && (binop.find(token.value) != binop.end());
-}
-
-std::unordered_map<string, std::pair<int, int>> map_prec = {
+// Operator properties, indexed by OP.
+constexpr auto op_info = [] {
+    std::array<OpInfo, static_cast<size_t>(OP::COUNT)> ret{};
+    auto binary = [&](OP op, int prec, int assoc_left) {
+        ret[static_cast<size_t>(op)].binary = true;
+        ret[static_cast<size_t>(op)].prec = prec;
+        ret[static_cast<size_t>(op)].assoc_left = assoc_left;
+    };
+    for (OP op : {OP::INC, OP::DEC, OP::ADD, OP::SUB, OP::NOT, OP::BIT_NOT, OP::MUL, OP::BIT_AND, OP::SIZEOF}) {
+        ret[static_cast<size_t>(op)].unary = true;
+    }
     // 13 multiplicative
-    {"*", {13, 1}},
-    {"/", {13, 1}},
-    {"%", {13, 1}},
+    binary(OP::MUL, 13, 1);
+    binary(OP::DIV, 13, 1);
+    binary(OP::MOD, 13, 1);
     // 12 additive
-    {"+", {12, 1}},
-    {"-", {12, 1}},
+    binary(OP::ADD, 12, 1);
+    binary(OP::SUB, 12, 1);
     // 11 shift
-    {"<<", {11, 1}},
-    {">>", {11, 1}},
+    binary(OP::SHL, 11, 1);
+    binary(OP::SHR, 11, 1);
     // 10 relational
-    {"<", {10, 1}},
-    {"<=", {10, 1}},
-    {">", {10, 1}},
-    {">=", {10, 1}},
+    binary(OP::LT, 10, 1);
+    binary(OP::LE, 10, 1);
+    binary(OP::GT, 10, 1);
+    binary(OP::GE, 10, 1);
     // 9 equality
-    {"==", {9, 1}},
-    {"!=", {9, 1}},
+    binary(OP::EQ, 9, 1);
+    binary(OP::NE, 9, 1);
     // 8 bitwise AND
-    {"&", {8, 1}},
+    binary(OP::BIT_AND, 8, 1);
     // 7 bitwise XOR
-    {"^", {7, 1}},
+    binary(OP::BIT_XOR, 7, 1);
     // 6 bitwise OR
-    {"|", {6, 1}},
+    binary(OP::BIT_OR, 6, 1);
     // 5 logical AND
-    {"&&", {5, 1}},
+    binary(OP::AND, 5, 1);
     // 4 logical OR
-    {"||", {4, 1}},
+    binary(OP::OR, 4, 1);
     // 3 tenary
-    {"?", {3, 0}},
+    binary(OP::QUESTION, 3, 0);
     // 2 assignment
-    {"=", {2, 0}},
-    {"+=", {2, 0}},
-    {"-=", {2, 0}},
-    {"*=", {2, 0}},
-    {"/=", {2, 0}},
-    {"%=", {2, 0}},
-    {"<<=", {2, 0}},
-    {">>=", {2, 0}},
-    {"&=", {2, 0}},
-    {"^=", {2, 0}},
-    {"|=", {2, 0}},
+    for (OP op : {OP::ASSIGN, OP::ADD_ASSIGN, OP::SUB_ASSIGN, OP::MUL_ASSIGN, OP::DIV_ASSIGN, OP::MOD_ASSIGN,
+                  OP::SHL_ASSIGN, OP::SHR_ASSIGN, OP::AND_ASSIGN, OP::XOR_ASSIGN, OP::OR_ASSIGN}) {
+        binary(op, 2, 0);
+    }
     // 1 comma
-    {",", {1, 1}}
-};
+    binary(OP::COMMA, 1, 1);
+    return ret;
+}();
+
+const OpInfo& info(OP op) { return op_info[static_cast<size_t>(op)]; }
+
+bool Parser::is_unary() {
+    return token.is_operator() && info(token.op).unary;
+}
+
+bool Parser::is_binary() {
+    return token.is_operator() && info(token.op).binary;
+}
 
 
 // <exp> ::= <factor> 
 //         | <exp> <binary-operator> <exp>
 //         | <exp> "?" <exp> ":" <exp>
-unique_ptr<Expression> Parser::expression(int min_prec) {
-    unique_ptr<Expression> left = factor();
-    while (is_binary()) {
-        auto [prec, assoc_left] = map_prec[token.value];
-        if (prec < min_prec) {
-            break;
+// Precedence climbing, with what each call would wait for kept on "frames" instead of the call stack.
+// Once an operand is parsed, it is handed to the innermost frame, which either asks for the next one
+// or is complete and hands on the node it built.
+Expression* Parser::expression(int min_prec) {
+    size_t base = frames.size();
+    frames.push_back({Frame::OPERATORS, min_prec});
+    Expression* value = nullptr;  // the operand just parsed, if any
+    while (true) {
+        if (!value) {
+            value = operand();
+            continue;
         }
-        unique_ptr<Expression> new_left = make_unique<Expression>(std::move(left), token.value);
-        left = std::move(new_left);
-        if (consume().value == "?") {
-            left->mid = expression();
-            match(TT::COLON);
-            left->right = expression(prec + assoc_left);
-        } else {
-            left->right = expression(prec + assoc_left);
+        Frame& top = frames.back();
+        switch (top.kind) {
+            case Frame::UNARY:
+                top.node->left = value;
+                value = top.node;
+                frames.pop_back();
+                break;
+            case Frame::PARENTHESIS:
+                match(TT::R_PARENTHESIS);
+                unnest();
+                frames.pop_back();
+                break;
+            case Frame::CALL:
+                scratch.push_back(value);
+                if (token.type == TT::COMMA) {
+                    consume();  // ","
+                    value = nullptr;
+                    frames.push_back({Frame::OPERATORS, 2});
+                } else {
+                    match(TT::R_PARENTHESIS);
+                    unnest();
+                    value = top.node;
+                    value->call = collect<Expression>(top.mark);
+                    frames.pop_back();
+                }
+                break;
+            case Frame::OPERATORS: {
+                Expression* op = top.node;
+                if (op && op->op == OP::QUESTION && !op->mid) {
+                    op->mid = value;
+                    match(TT::COLON);
+                    value = nullptr;
+                    frames.push_back({Frame::OPERATORS, info(OP::QUESTION).prec + info(OP::QUESTION).assoc_left});
+                    break;
+                }
+                if (op) {
+                    op->right = value;
+                    value = op;
+                    top.node = nullptr;
+                }
+                if (top.run != OP::NONE) {
+                    scratch.push_back(value);
+                    if (is_operator(top.run)) {
+                        consume();  // the run goes on
+                        value = nullptr;
+                        frames.push_back({Frame::OPERATORS, info(top.run).prec + 1});
+                        break;
+                    }
+                    value = chain(top.run, top.mark);
+                    top.run = OP::NONE;
+                }
+                if (is_binary() && info(token.op).prec >= top.min_prec) {
+                    auto [unary, binary, prec, assoc_left] = info(token.op);
+                    if (tree.n_ary && assoc_left) {
+                        top.run = token.op;
+                        top.mark = scratch.size();
+                        scratch.push_back(value);
+                    } else {
+                        top.node = arena->make<Expression>(value, token.op);
+                    }
+                    value = nullptr;
+                    // the middle of "?:" is a whole expression
+                    frames.push_back({Frame::OPERATORS, consume().op == OP::QUESTION ? 0 : prec + assoc_left});
+                } else {
+                    frames.pop_back();
+                    if (frames.size() == base) {
+                        return value;
+                    }
+                }
+                break;
+            }
         }
     }
-    return left;
 }
 
 // <factor> ::= <int>
@@ -404,42 +671,71 @@ unique_ptr<Expression> Parser::expression(int min_prec) {
 //            | "(" <exp> ")"
 //            | <identifier>
 //            | <identifier> "(" [ <argument-list> ] ")"
-unique_ptr<Expression> Parser::factor() {
+// <argument-list> ::= <exp> { "," <exp> }
+// Return a factor that is complete at once, or push the frames for what it starts and return nullptr.
+Expression* Parser::operand() {
     if (token.type == TT::NUMBER) {
-        return make_unique<Constant>(stoi(consume().value));
+        std::string_view digits = consume().value;
+        int val = 0;
+        if (std::from_chars(digits.data(), digits.data() + digits.size(), val).ec != std::errc()) {
+            parser_error("integer constant is too large", token.row);
+        }
+        return arena->make<Constant>(val);
     } else if (is_unary()) {
-        unique_ptr<Expression> ret = make_unique<Expression>(consume().value);
-        ret->left = factor();
-        return ret;
+        frames.push_back({Frame::UNARY, 0, arena->make<Expression>(consume().op)});
+        return nullptr;
     } else if (token.type == TT::L_PARENTHESIS) {
         consume();  // "("
-        unique_ptr<Expression> ret = expression();
-        match(TT::R_PARENTHESIS);
+        nest();
+        frames.push_back({Frame::PARENTHESIS});
+        frames.push_back({Frame::OPERATORS, 0});
+        return nullptr;
+    }
+    Expression* ret = arena->make<Expression>(identifier());
+    if (token.type != TT::L_PARENTHESIS) {
         return ret;
-    } else {
-        unique_ptr<Expression> ret = make_unique<Expression>(identifier());
-        if (token.type == TT::L_PARENTHESIS) {
-            consume();  // "("
-            ret->call = argument_list();
-            match(TT::R_PARENTHESIS);
-        }
+    }
+    consume();  // "("
+    ret->is_call = true;
+    if (token.type == TT::R_PARENTHESIS) {
+        consume();  // ")"
         return ret;
     }
+    nest();
+    frames.push_back({Frame::CALL, 0, ret, scratch.size()});
+    frames.push_back({Frame::OPERATORS, 2});  // the commas separate the arguments
+    return nullptr;
 }
 
-// <argument-list> ::= <exp> { "," <exp> }
-vector<unique_ptr<Expression>> Parser::argument_list() {
-    vector<unique_ptr<Expression>> ret;
-    while (true) {
-        consume();  // "," or begining "("
-        ret.push_back(expression());
-    } while (token.type == TT::COMMA)
+// The node for a run of "op" over the operands from "mark" on scratch: a Chain of three or more,
+// or a binary node for two.
+Expression* Parser::chain(OP op, size_t mark) {
+    if (scratch.size() - mark == 2) {
+        Expression* ret = arena->make<Expression>(static_cast<Expression*>(scratch[mark]), op);
+        ret->right = static_cast<Expression*>(scratch[mark + 1]);
+        scratch.resize(mark);
+        return ret;
+    }
+    Chain* ret = arena->make<Chain>(op);
+    ret->operands = collect<Expression>(mark);
     return ret;
 }
 
-string Parser::identifier() {
+void Parser::nest() {
+    if (++nesting > tree.max_nesting) {
+        parser_error(std::format("brackets nested too deeply (the limit is {})", tree.max_nesting), token.row);
+    }
+}
+
+Symbol Parser::identifier() {
     if (token.type != TT::IDENTIFIER) {
         parser_error("expected an identifier", token.row);
     }
-    return consume().value;
+    if (span) {
+        // the current token is the one before span->pos
+        Symbol ret = span->names[span->pos - span->begin - 1];
+        consume();
+        return ret;
+    }
+    return symbols->intern(consume().value);
 }
\ No newline at end of file
@@ -1,46 +1,173 @@
+#ifndef HEADER_PARSER
+#define HEADER_PARSER
+
+#include <functional>
+#include <utility>
+
 #include "error.h"
 #include "lexer.h"
 #include "AST.h"
+#include "pipeline.h"
+
+
+// How deeply brackets may nest by default: "(" and "{" of any kind. Parsing them takes no call stack.
+constexpr unsigned DEFAULT_NESTING = 1 << 20;
+// Parameter lists within parameter lists are parsed and printed by recursion, so they have a fixed limit.
+constexpr unsigned MAX_PARAMETER_NESTING = 1 << 10;
 
+// How the tree is built, the same for every parser that takes part in parsing a file.
+struct TreeOptions {
+    unsigned max_nesting = DEFAULT_NESTING;  // of brackets, deeper is a parse error
+    bool n_ary = false;  // a run of one left-associative operator, "a + b + c", as one Chain node
+};
 
+// Tokens lexed beforehand, for parsing a part of a file on its own.
+struct TokenSpan {
+    const Token* pos;              // the next token to be returned
+    const Token* begin;
+    const Token* end;
+    const Symbol* names;           // interned identifiers, parallel to [begin, end)
+    Token last;                    // END, at the position of whatever follows the span
+    const CompileError* error;     // thrown instead of "last", if set
+};
 
 class Parser {
 public:
-    Parser(Lexer& l, bool flag): lexer(l), par_flag(flag) {
-        token = lexer.next();
+    Parser(Lexer& l, bool flag, Output& o = standard_output(), bool c = true)
+        : lexer(&l), par_flag(flag), out(o), color(c) {
+        token = next();
+    }
+    // Take the tokens from a pipeline, i.e., lexed on another thread.
+    Parser(Pipeline& p, bool flag, Output& o = standard_output(), bool c = true)
+        : pipeline(&p), par_flag(flag), out(o), color(c) {
+        token = next();
+    }
+    // Take the tokens from a span, with the identifiers already interned.
+    Parser(TokenSpan& s, bool flag, Output& o = standard_output(), bool c = true)
+        : span(&s), par_flag(flag), out(o), color(c) {
+        token = next();
     }
     unique_ptr<Program> program();
+    // Skip function bodies by matching braces instead of parsing them; expand() parses one later.
+    // Only the tokens straight from a Lexer can be skipped, so this is ignored for the other sources.
+    void defer_bodies(bool on) { lazy = on; }
+    // Parse a "{ ... }" function body into "program".
+    Block* function_body(Program& program);
+    // Parse the declarations up to END into "decls", with the nodes allocated from "a",
+    // and where each of them is into "spans".
+    void declarations(Arena& a, vector<AST*>& decls, vector<SourceRange>& spans);
+    // Parse the declarations one at a time instead, pulling each with next_declaration() while !done().
+    // It is allocated in "program" but not added to it, and "span" is set to where it is, so the caller
+    // may keep it or free it with program.arena.rewind().
+    AST* next_declaration(Program& program, SourceRange& span);
+    bool done() const { return token.type == TT::END; }
+    // Or have them pushed: each(declaration, span) is called as soon as one is parsed, and those it
+    // returns true for are added to "program". The others are freed at once, so that memory is bounded
+    // by the largest declaration rather than by the file, and so is one cut short by an error.
+    void stream(Program& program, const std::function<bool(AST*, const SourceRange&)>& each);
+    // Intern names into "s", e.g., those of a program parsed before.
+    void use_symbols(Interner& s) { symbols = &s; }
+    void configure(const TreeOptions& t) { tree = t; }
 private:
-    Lexer& lexer;
+    Lexer* lexer = nullptr;
+    Pipeline* pipeline = nullptr;  // where the tokens come from instead of "lexer", if set
+    TokenSpan* span = nullptr;     // likewise
     Token token;    // current token, i.e., the next token to be used
     bool par_flag;  // whether to print the AST
-    Token consume() {
-        Token ret = token;
-        token = lexer.next();
+    Output& out;
+    bool color;
+    bool lazy = false;                // whether to skip function bodies
+    Arena* arena = nullptr;           // arena of the program being parsed
+    Interner* symbols = nullptr;      // names of the program being parsed
+    vector<AST*> scratch;             // children of the lists being parsed
+    vector<Parameter> scratch_params;
+    TreeOptions tree;
+    unsigned nesting = 0;             // brackets open
+    unsigned parameter_nesting = 0;   // parameter lists open
+    // An expression being parsed, kept here instead of on the call stack (see expression()).
+    struct Frame {
+        enum Kind : uint8_t {
+            OPERATORS,    // binary operators from "min_prec" up, with "node" waiting for its right operand,
+                          // or the operands of a run of "run" so far from "mark" on scratch
+            UNARY,        // "node" waiting for its operand
+            PARENTHESIS,  // waiting for ")"
+            CALL          // "node" waiting for its next argument, those before from "mark" on scratch
+        } kind;
+        int min_prec = 0;
+        Expression* node = nullptr;
+        size_t mark = 0;
+        OP run = OP::NONE;
+    };
+    vector<Frame> frames;
+    // A statement that contains others, waiting for the next of them;
+    // for a block, its items so far are from "mark" on scratch.
+    struct OpenStatement {
+        Statement* node;
+        size_t mark;
+    };
+    vector<OpenStatement> open_statements;
+    vector<std::pair<Initializer*, size_t>> open_lists;  // initializer lists, likewise
+    // Copy the children pushed since "mark" into the arena and pop them.
+    template <class T>
+    List<T*> collect(size_t mark) {
+        List<T*> ret = arena->list<T*>(scratch.begin() + mark, scratch.end());
+        scratch.resize(mark);
         return ret;
+    }
+    Token next() {
+        if (pipeline) {
+            return pipeline->next();
+        }
+        if (span) {
+            if (span->pos != span->end) {
+                return *span->pos++;
+            }
+            if (span->error) {
+                throw *span->error;
+            }
+            return span->last;
+        }
+        return lexer->next();
+    }
+    // Token only holds a view of its value, so handing it out is cheap.
+    Token consume() {
+        return std::exchange(token, next());
     };
     void match(TT t);
     bool is_specifier() { return token.is_specifier(); }
-    bool is_operator(string s="") { return token.is_operator(s); }
+    bool is_operator(OP o=OP::NONE) { return token.is_operator(o); }
     bool is_unary();
     bool is_binary();
-    unique_ptr<AST> declaration(bool global);
+    AST* declaration(bool global);
     CType specifier(bool global);
     CType type_specifier();
     Declarator declarator();
-    vector<Parameter> parameter_list();
+    void declarator_suffix(Declarator& d);
+    List<Parameter> parameter_list();
     Parameter parameter();
-    unique_ptr<Initializer> initializer();
+    Initializer* initializer();
+    SourceRange skip_body();
 
-    unique_ptr<Statement> statement();
-    unique_ptr<Block> block();
+    Statement* statement();
+    Block* block();
+    Statement* open_statement();
+    void open_block();
+    Statement* statements(size_t base, Statement* done);
 
 
-    unique_ptr<Expression> expression(int min_prec=0);
-    unique_ptr<Expression> factor();
-    vector<unique_ptr<Expression>> argument_list();
-    string identifier();
+    Expression* expression(int min_prec=0);
+    Expression* operand();
+    Expression* chain(OP op, size_t mark);
+    Symbol identifier();
+    void nest();
+    void unnest() { --nesting; }
 
 
     // void struct_declaration();
-};
\ No newline at end of file
+};
+
+// Parse the body of a function skipped by a lazy parse.
+// "text" is the whole source the program was parsed from.
+void expand(Program& program, Function* function, std::string_view text, const TreeOptions& tree = {});
+
+#endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <cassert>
+
+#include "pipeline.h"
+
+Pipeline::Pipeline(Lexer& l) : lexer(l), producer(&Pipeline::produce, this) {}
+
+Pipeline::~Pipeline() {
+    stopping = true;
+    producer.join();
+}
+
+void Pipeline::produce() {
+    Token t;
+    do {
+        try {
+            t = lexer.next();
+        } catch (...) {
+            error = std::current_exception();
+            t = Token{TT::END, {}, 0, 0};
+        }
+        while (!ring.try_push(t)) {
+            if (stopping.load(std::memory_order_relaxed)) {
+                return;  // the parser has given up
+            }
+            std::this_thread::yield();
+        }
+    } while (t.type != TT::END);
+    finished.store(true, std::memory_order_release);
+}
+
+Token Pipeline::next() {
+    while (!ring.try_pop(last)) {
+        std::this_thread::yield();
+    }
+    if (last.type == TT::END && error) {
+        std::rethrow_exception(error);
+    }
+    return last;
+}
+
+const Token& Pipeline::peek(size_t k) {
+    assert(1 <= k && k <= CAPACITY);  // the ring never holds more, so waiting for more would never end
+    while (true) {
+        if (const Token* t = ring.peek(k - 1)) {
+            return *t;
+        }
+        if (finished.load(std::memory_order_acquire)) {
+            // Everything has been pushed and the END token is the last one.
+            size_t n = ring.size();
+            return n != 0 ? *ring.peek(n - 1) : last;
+        }
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef HEADER_PIPELINE
+#define HEADER_PIPELINE
+
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "lexer.h"
+#include "ring.h"
+
+// Runs a Lexer on its own thread, filling a ring of tokens ahead of the parser,
+// so lexing and parsing overlap on two cores.
+// The lexer must not be used by anyone else while the pipeline exists.
+class Pipeline {
+public:
+    explicit Pipeline(Lexer& l);
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+    ~Pipeline();  // stops the lexer if it is still running
+    // The next token; a lexer error is thrown here, in place of the token where it happened.
+    Token next();
+    // The k-th token after the one last returned by next(), for 1 <= k <= CAPACITY.
+    // Past the end, this is the END token.
+    const Token& peek(size_t k);
+    static constexpr size_t CAPACITY = 1 << 12;
+private:
+    Lexer& lexer;
+    Ring<Token, CAPACITY> ring;
+    std::exception_ptr error;            // set by the producer before it pushes its last token
+    std::atomic<bool> finished = false;  // the last token has been pushed
+    std::atomic<bool> stopping = false;  // the consumer is gone
+    Token last;                          // the token last returned by next()
+    std::thread producer;                // started last, once everything above is ready
+    void produce();
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include "pool.h"
+
+Pool::Pool(unsigned threads) {
+    threads = std::max(threads, 1u);
+    for (unsigned i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(&Pool::work, this, i);
+    }
+}
+
+Pool::~Pool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void Pool::submit(std::function<void()> task) {
+    Queue& q = *queues[next];
+    next = (next + 1) % queues.size();
+    {
+        std::lock_guard<std::mutex> guard(q.lock);
+        q.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ++queued;
+    }
+    wake.notify_one();
+}
+
+// Take the oldest task of our own queue, or steal the oldest of another.
+bool Pool::take(size_t self, std::function<void()>& task) {
+    for (size_t i = 0; i != queues.size(); ++i) {
+        Queue& q = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.tasks.empty()) {
+            continue;
+        }
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void Pool::work(size_t self) {
+    std::function<void()> task;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return queued != 0 || stopping; });
+            if (queued == 0) {
+                return;  // stopping, and nothing is left
+            }
+            --queued;
+        }
+        // A task is reserved for us, though another worker may have to be robbed of it.
+        while (!take(self, task)) {
+            std::this_thread::yield();
+        }
+        task();
+        task = nullptr;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef HEADER_POOL
+#define HEADER_POOL
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads with work stealing.
+// Every worker owns a queue: it takes its own tasks from the front and,
+// once that is empty, steals from the front of the others, so a few slow files don't idle the rest.
+// Tasks run roughly in the order they were submitted, which lets callers consume results in that order.
+class Pool {
+public:
+    explicit Pool(unsigned threads);
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+    ~Pool();  // waits for the tasks left
+    // Tasks are dealt to the queues in turn.
+    void submit(std::function<void()> task);
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex lock;                   // guards the two below, for sleeping
+    std::condition_variable wake;
+    size_t queued = 0;                 // tasks submitted but not yet taken
+    bool stopping = false;
+    size_t next = 0;                   // queue for the next submitted task
+    bool take(size_t self, std::function<void()>& task);
+    void work(size_t self);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef HEADER_RING
+#define HEADER_RING
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+// Each side owns one index and only reads the other's, refreshing its cached copy
+// when the ring looks full (or empty), so the shared cache lines are rarely touched.
+template <class T, size_t N>
+class Ring {
+    static_assert((N & (N - 1)) == 0, "the capacity must be a power of 2");
+public:
+    // producer
+    bool try_push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache == N) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache == N) {
+                return false;
+            }
+        }
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer
+    bool try_pop(T& item) {
+        if (!available(1)) {
+            return false;
+        }
+        size_t h = head.load(std::memory_order_relaxed);
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    // The k-th item after the next one to be popped (0 for that one), or nullptr if not pushed yet.
+    const T* peek(size_t k) {
+        if (!available(k + 1)) {
+            return nullptr;
+        }
+        return &items[(head.load(std::memory_order_relaxed) + k) & (N - 1)];
+    }
+    // Number of items the consumer can see.
+    size_t size() {
+        available(N);
+        return tail_cache - head.load(std::memory_order_relaxed);
+    }
+private:
+    // Whether n items are ready for the consumer.
+    bool available(size_t n) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (tail_cache - h < n) {
+            tail_cache = tail.load(std::memory_order_acquire);
+        }
+        return tail_cache - h >= n;
+    }
+    static constexpr size_t LINE = 64;
+    alignas(LINE) std::atomic<size_t> head = 0;  // written by the consumer
+    size_t tail_cache = 0;                       // consumer's copy of tail
+    alignas(LINE) std::atomic<size_t> tail = 0;  // written by the producer
+    size_t head_cache = 0;                       // producer's copy of head
+    alignas(LINE) T items[N];
+};
+
+#endif
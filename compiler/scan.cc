@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <string_view>
+
+#include "scan_impl.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef GARDENIA_AVX2
+extern const ScanKernels avx2_kernels;  // scan_avx2.cc
+#endif
+
+namespace {
+
+constexpr ScanKernels scalar_kernels = {
+    "scalar", scalar_skip_space, scalar_skip_ident, scalar_skip_digits, scalar_find_line_end,
+    [](const char* p, const char* end) { return scalar_find_comment_end(p, end); },
+    scalar_find_string_end,
+    [](const char* p, const char* end) { return scalar_count_lines(p, end); }
+};
+
+#ifdef __SSE2__
+struct SSE2 {
+    using reg = __m128i;
+    static constexpr int WIDTH = 16;
+    static reg load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const reg*>(p)); }
+    static reg eq(reg x, char c) { return _mm_cmpeq_epi8(x, _mm_set1_epi8(c)); }
+    // lo <= x <= hi, as unsigned bytes
+    static reg range(reg x, char lo, char hi) {
+        reg t = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(hi - lo)), t);
+    }
+    static uint32_t bits(reg x) { return static_cast<uint32_t>(_mm_movemask_epi8(x)); }
+};
+
+constexpr ScanKernels sse2_kernels = Kernels<SSE2>::table("sse2");
+#endif
+
+const ScanKernels& pick_kernels() {
+    const char* env = getenv("GARDENIA_SCAN");
+    std::string_view want = env ? env : "";
+    if (want == "scalar") {
+        return scalar_kernels;
+    }
+#ifdef GARDENIA_AVX2
+    if (want != "sse2" && __builtin_cpu_supports("avx2")) {
+        return avx2_kernels;
+    }
+#endif
+#ifdef __SSE2__
+    return sse2_kernels;
+#else
+    return scalar_kernels;
+#endif
+}
+
+}  // namespace
+
+const ScanKernels& scan_kernels() {
+    static const ScanKernels& kernels = pick_kernels();
+    return kernels;
+}
@@ -0,0 +1,30 @@
+#ifndef HEADER_SCAN
+#define HEADER_SCAN
+
+#include <cstddef>
+
+// Newlines in a range of the source.
+struct Lines {
+    size_t count = 0;
+    const char* last = nullptr;  // position right after the last '\n'
+};
+
+// Kernels for the longest loops of the lexer.
+// Each one scans [p, end) and returns the first position that stops it, or end.
+// A '\0' byte is the end of input for the lexer, so the find_* kernels stop there too.
+struct ScanKernels {
+    const char* name;
+    const char* (*skip_space)(const char* p, const char* end);        // first non-space
+    const char* (*skip_ident)(const char* p, const char* end);        // first not in [0-9A-Za-z_]
+    const char* (*skip_digits)(const char* p, const char* end);       // first non-digit
+    const char* (*find_line_end)(const char* p, const char* end);     // first '\n'
+    const char* (*find_comment_end)(const char* p, const char* end);  // the '/' of the first "*/"
+    const char* (*find_string_end)(const char* p, const char* end);   // first '"' or '\\'
+    Lines (*count_lines)(const char* p, const char* end);
+};
+
+// The fastest kernels the CPU supports (AVX2, SSE2 or scalar), picked once.
+// GARDENIA_SCAN=scalar|sse2|avx2 in the environment forces a choice.
+const ScanKernels& scan_kernels();
+
+#endif
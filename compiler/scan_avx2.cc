@@ -0,0 +1,23 @@
+// Compiled with -mavx2; only called after the CPU has been checked.
+#include <immintrin.h>
+
+#include "scan_impl.h"
+
+namespace {
+
+struct AVX2 {
+    using reg = __m256i;
+    static constexpr int WIDTH = 32;
+    static reg load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const reg*>(p)); }
+    static reg eq(reg x, char c) { return _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c)); }
+    // lo <= x <= hi, as unsigned bytes
+    static reg range(reg x, char lo, char hi) {
+        reg t = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(hi - lo)), t);
+    }
+    static uint32_t bits(reg x) { return static_cast<uint32_t>(_mm256_movemask_epi8(x)); }
+};
+
+}  // namespace
+
+extern const ScanKernels avx2_kernels = Kernels<AVX2>::table("avx2");
@@ -0,0 +1,158 @@
+// Shared by scan.cc and scan_avx2.cc, which are compiled with different target flags.
+// Everything stays in an anonymous namespace so the two builds never get merged by the linker.
+
+#include <bit>
+#include <cstdint>
+
+#include "scan.h"
+
+namespace {
+
+// scalar versions, also used for the tails shorter than a vector
+inline bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+inline bool is_ident(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+const char* scalar_skip_space(const char* p, const char* end) {
+    while (p != end && is_space(*p)) { ++p; }
+    return p;
+}
+
+const char* scalar_skip_ident(const char* p, const char* end) {
+    while (p != end && is_ident(*p)) { ++p; }
+    return p;
+}
+
+const char* scalar_skip_digits(const char* p, const char* end) {
+    while (p != end && is_digit(*p)) { ++p; }
+    return p;
+}
+
+const char* scalar_find_line_end(const char* p, const char* end) {
+    while (p != end && *p != '\n' && *p != '\0') { ++p; }
+    return p;
+}
+
+// "star" tells whether the byte before p is a '*' of the same comment.
+const char* scalar_find_comment_end(const char* p, const char* end, bool star = false) {
+    for (; p != end; ++p) {
+        if (*p == '\0' || (*p == '/' && star)) {
+            return p;
+        }
+        star = (*p == '*');
+    }
+    return end;
+}
+
+const char* scalar_find_string_end(const char* p, const char* end) {
+    while (p != end && *p != '"' && *p != '\\' && *p != '\0') { ++p; }
+    return p;
+}
+
+Lines scalar_count_lines(const char* p, const char* end, Lines ret = {}) {
+    for (; p != end; ++p) {
+        if (*p == '\n') {
+            ++ret.count;
+            ret.last = p + 1;
+        }
+    }
+    return ret;
+}
+
+// Vector kernels over a traits class V, which provides:
+//   WIDTH, load(p), eq(x, c), range(x, lo, hi), bits(x) -> uint32_t with one bit per byte.
+template <class V>
+struct Kernels {
+    static constexpr int W = V::WIDTH;
+    static constexpr uint32_t FULL = W == 32 ? ~0u : (1u << W) - 1;
+
+    static uint32_t space(typename V::reg x) {
+        return V::bits(V::eq(x, ' ')) | V::bits(V::range(x, '\t', '\r'));
+    }
+    static uint32_t ident(typename V::reg x) {
+        return V::bits(V::range(x, '0', '9')) | V::bits(V::range(x, 'a', 'z'))
+             | V::bits(V::range(x, 'A', 'Z')) | V::bits(V::eq(x, '_'));
+    }
+
+    static const char* skip_space(const char* p, const char* end) {
+        for (; end - p >= W; p += W) {
+            if (uint32_t m = ~space(V::load(p)) & FULL) {
+                return p + std::countr_zero(m);
+            }
+        }
+        return scalar_skip_space(p, end);
+    }
+
+    static const char* skip_ident(const char* p, const char* end) {
+        for (; end - p >= W; p += W) {
+            if (uint32_t m = ~ident(V::load(p)) & FULL) {
+                return p + std::countr_zero(m);
+            }
+        }
+        return scalar_skip_ident(p, end);
+    }
+
+    static const char* skip_digits(const char* p, const char* end) {
+        for (; end - p >= W; p += W) {
+            if (uint32_t m = ~V::bits(V::range(V::load(p), '0', '9')) & FULL) {
+                return p + std::countr_zero(m);
+            }
+        }
+        return scalar_skip_digits(p, end);
+    }
+
+    static const char* find_line_end(const char* p, const char* end) {
+        for (; end - p >= W; p += W) {
+            auto x = V::load(p);
+            if (uint32_t m = V::bits(V::eq(x, '\n')) | V::bits(V::eq(x, '\0'))) {
+                return p + std::countr_zero(m);
+            }
+        }
+        return scalar_find_line_end(p, end);
+    }
+
+    // A "*/" may straddle two blocks, so the last '*' of a block is carried over.
+    static const char* find_comment_end(const char* p, const char* end) {
+        uint32_t carry = 0;
+        for (; end - p >= W; p += W) {
+            auto x = V::load(p);
+            uint32_t star = V::bits(V::eq(x, '*'));
+            uint32_t m = (V::bits(V::eq(x, '/')) & ((star << 1) | carry)) | V::bits(V::eq(x, '\0'));
+            if (m) {
+                return p + std::countr_zero(m);
+            }
+            carry = star >> (W - 1);
+        }
+        return scalar_find_comment_end(p, end, carry);
+    }
+
+    static const char* find_string_end(const char* p, const char* end) {
+        for (; end - p >= W; p += W) {
+            auto x = V::load(p);
+            if (uint32_t m = V::bits(V::eq(x, '"')) | V::bits(V::eq(x, '\\')) | V::bits(V::eq(x, '\0'))) {
+                return p + std::countr_zero(m);
+            }
+        }
+        return scalar_find_string_end(p, end);
+    }
+
+    static Lines count_lines(const char* p, const char* end) {
+        Lines ret;
+        for (; end - p >= W; p += W) {
+            if (uint32_t m = V::bits(V::eq(V::load(p), '\n'))) {
+                ret.count += std::popcount(m);
+                ret.last = p + (32 - std::countl_zero(m));
+            }
+        }
+        return scalar_count_lines(p, end, ret);
+    }
+
+    static constexpr ScanKernels table(const char* name) {
+        return {name, skip_space, skip_ident, skip_digits, find_line_end,
+                find_comment_end, find_string_end, count_lines};
+    }
+};
+
+}  // namespace
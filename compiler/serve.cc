@@ -0,0 +1,236 @@
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "driver.h"
+#include "serve.h"
+
+// The workspace is started afresh once it holds this many names, as they are never freed otherwise.
+static constexpr size_t MAX_SYMBOLS = 1 << 20;
+
+string Session::answer(std::string_view request, bool& quit) {
+    size_t newline = request.find('\n');
+    std::string_view line = request.substr(0, newline);
+    std::string_view source = newline == std::string_view::npos ? std::string_view() : request.substr(newline + 1);
+    vector<string> words;
+    for (size_t i = 0; i < line.size(); ) {
+        size_t space = std::min(line.find(' ', i), line.size());
+        if (space != i) {
+            words.emplace_back(line.substr(i, space - i));
+        }
+        i = space + 1;
+    }
+    if (words.empty()) {
+        return "bad request\nempty request\n";
+    }
+    const string& command = words[0];
+    if (command == "quit") {
+        quit = true;
+        return "ok\n";
+    }
+    if (command != "print" && command != "lex" && command != "parse") {
+        return "bad request\nunknown command " + command + "\n";
+    }
+    Options options;
+    string path;
+    for (size_t i = 1; i < words.size(); ++i) {
+        string error;
+        if (set_option(words, i, options, error)) {
+            if (!error.empty()) {
+                return "bad request\n" + error + "\n";
+            }
+        } else if (words[i].starts_with("--")) {
+            return "bad request\nunknown option " + words[i] + "\n";
+        } else if (path.empty()) {
+            path = words[i];
+        } else {
+            return "bad request\nmore than one path\n";
+        }
+    }
+    if (path.empty()) {
+        return "bad request\nno path\n";
+    }
+    if (command != "print") {
+        options.lex = command == "lex";
+        options.parse = false;
+        options.emit = Emit::TEXT;
+    }
+    if (!workspace || workspace->symbols.size() > MAX_SYMBOLS) {
+        workspace = make_unique<Program>();
+    }
+    options.workspace = workspace.get();
+
+    string output;
+    string report;
+    {
+        Output out(output);
+        try {
+            std::optional<Lexer> lexer;
+            if (path == "-") {
+                lexer.emplace(source.data(), source.size(), options.lex, out, options.color);
+            } else {
+                lexer.emplace(path, options.lex, out, options.color);
+            }
+            if (command == "lex") {
+                while (lexer->next().type != TT::END) {}
+            } else {
+                compile(*lexer, options, out);
+            }
+        } catch (const CompileError& e) {
+            report = error_text(e, options.color);
+        }
+    }
+    if (report.empty()) {
+        return "ok\n" + output;
+    }
+    return std::format("error {}\n", output.size()) + output + report;
+}
+
+FrameRead read_frame(int fd, string& payload, size_t limit) {
+    auto read_all = [fd](char* p, size_t n) {
+        while (n != 0) {
+            ssize_t got = read(fd, p, n);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                return false;
+            }
+            p += got;
+            n -= got;
+        }
+        return true;
+    };
+    unsigned char head[4];
+    if (!read_all(reinterpret_cast<char*>(head), sizeof(head))) {
+        return FrameRead::END;
+    }
+    uint32_t size = head[0] | head[1] << 8 | head[2] << 16 | static_cast<uint32_t>(head[3]) << 24;
+    if (size > limit) {
+        payload.clear();
+        return FrameRead::TOO_LONG;
+    }
+    payload.resize(size);
+    return read_all(payload.data(), size) ? FrameRead::OK : FrameRead::END;
+}
+
+bool write_frame(int fd, std::string_view payload) {
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    char head[4] = {static_cast<char>(size), static_cast<char>(size >> 8),
+                    static_cast<char>(size >> 16), static_cast<char>(size >> 24)};
+    for (std::string_view part : {std::string_view(head, sizeof(head)), payload}) {
+        while (!part.empty()) {
+            ssize_t n = write(fd, part.data(), part.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            part.remove_prefix(n);
+        }
+    }
+    return true;
+}
+
+// Answer the requests on one connection until it closes. Returns whether it asked to quit.
+static bool serve_connection(int in, int out) {
+    Session session;
+    string request;
+    bool quit = false;
+    while (!quit) {
+        FrameRead got = read_frame(in, request, MAX_REQUEST);
+        if (got == FrameRead::TOO_LONG) {
+            // The rest of it cannot be told from the next request, so the connection ends here.
+            write_frame(out, std::format("bad request\nrequest longer than {} bytes\n", MAX_REQUEST));
+            break;
+        }
+        if (got != FrameRead::OK || !write_frame(out, session.answer(request, quit))) {
+            break;
+        }
+    }
+    return quit;
+}
+
+static bool socket_address(const string& path, sockaddr_un& addr) {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool serve(const string& path) {
+    signal(SIGPIPE, SIG_IGN);  // a client that went away is only an error on its connection
+    if (path == "-") {
+        serve_connection(STDIN_FILENO, STDOUT_FILENO);
+        return true;
+    }
+    auto fail = [&](const string& why) {
+        cerr << COLOR_ERROR << "error: " << COLOR_RESET << why << ' ' << path << endl;
+        return false;
+    };
+    sockaddr_un addr;
+    if (!socket_address(path, addr)) {
+        return fail("socket path too long:");
+    }
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            return fail("not a socket:");
+        }
+        unlink(path.c_str());  // left by a server before
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(listener, 64) != 0) {
+        return fail("cannot listen on");
+    }
+    // Shared with the connections, which may outlive this function when one of them asks to quit.
+    auto stopping = std::make_shared<std::atomic<bool>>(false);
+    bool ok = true;
+    while (!*stopping) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (stopping->exchange(true)) {
+                break;  // shut down by "quit"
+            }
+            // e.g., out of file descriptors; setting "stopping" keeps a later "quit" off the closed listener
+            ok = fail(string("cannot accept connections (") + strerror(errno) + ") on");
+            break;
+        }
+        std::thread([fd, listener, stopping] {
+            if (serve_connection(fd, fd) && !stopping->exchange(true)) {
+                shutdown(listener, SHUT_RDWR);  // wakes up accept()
+            }
+            close(fd);
+        }).detach();
+    }
+    close(listener);
+    unlink(path.c_str());
+    return ok;
+}
+
+int connect_to(const string& path) {
+    sockaddr_un addr;
+    if (!socket_address(path, addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
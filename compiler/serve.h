@@ -0,0 +1,48 @@
+#ifndef HEADER_SERVE
+#define HEADER_SERVE
+
+#include <string>
+#include <string_view>
+
+#include "AST.h"
+
+// Server mode: one process that stays warm answers requests to lex, parse, or print files or buffers,
+// so callers such as editors pay neither process startup nor cold caches for each of them.
+//
+// Every message is a frame: its length as 4 bytes, little-endian, then that many bytes.
+// A request is a line of words separated by spaces, followed by the source if the path is "-":
+//   print [options] PATH     the output of the command line, which takes the same options of a file
+//                            (--lex, --no-color, --emit-ast=..., --signatures-only, --only NAME, ...)
+//   lex [options] PATH       the tokens alone
+//   parse [options] PATH     nothing but whether it parses
+//   quit                     stop the server
+// The response starts with a line, "ok", "error N", or "bad request", followed by the output.
+// After "error N", the first N bytes are the output so far, and the rest is the report of the error,
+// as the command line prints it on stderr; after "bad request", the reason follows.
+// A request longer than MAX_REQUEST is answered with "bad request" and its connection is closed;
+// larger sources are sent by path.
+constexpr size_t MAX_REQUEST = 64 << 20;
+
+// Serve on the Unix domain socket at "path", or on stdin and stdout if it is "-", until a "quit" request.
+// Connections to the socket are served on threads of their own. Returns false if it could not start.
+bool serve(const string& path);
+
+// What a connection keeps between requests: a program that is parsed into again and again,
+// so its arena blocks and interned names are reused.
+class Session {
+public:
+    // Answer one request; "quit" is set if it asks the server to stop.
+    string answer(std::string_view request, bool& quit);
+private:
+    unique_ptr<Program> workspace;
+};
+
+// Frames on a file descriptor. read_frame() reads none of a frame longer than "limit".
+enum struct FrameRead { OK, END, TOO_LONG };  // END at the end of the stream or on an error
+FrameRead read_frame(int fd, string& payload, size_t limit = SIZE_MAX);
+bool write_frame(int fd, std::string_view payload);
+
+// Connect to the server at the socket "path"; -1 on failure.
+int connect_to(const string& path);
+
+#endif
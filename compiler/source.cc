@@ -0,0 +1,36 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+
+Source::Source(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        file_error("failed to open the file");
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size != 0) {  // mmap rejects empty mappings
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            file_error("failed to map the file");
+        }
+        madvise(p, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(p);
+        mapped = true;
+    }
+    close(fd);  // the mapping stays valid after closing
+}
+
+Source::~Source() {
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef HEADER_SOURCE
+#define HEADER_SOURCE
+
+#include <string>
+#include <string_view>
+
+#include "error.h"
+
+// Read-only source text.
+// A file is mapped into memory as a whole, while an in-memory buffer is used in place (not copied).
+class Source {
+public:
+    Source(const string& path);
+    Source(const char* buf, size_t len) : data(buf), size(len) {}
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+    ~Source();
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+    size_t length() const { return size; }
+    std::string_view view() const { return {data, size}; }
+private:
+    const char* data = nullptr;
+    size_t size = 0;      // 64-bit, so files larger than 2 GB are fine
+    bool mapped = false;  // whether "data" needs munmap
+};
+
+#endif
@@ -0,0 +1,54 @@
+// Globals of several types and declarators.
+static int count = 0;
+extern long total;
+unsigned int mask = ~0;
+char *names[4][2];
+int grid[3][3] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+double ratio;
+long **table = 0;
+
+int helper(void);
+int add(int a, int b);
+static long scale(long x, int factor);
+
+/* A block comment
+   over lines, with { braces } and "quotes" inside. */
+int add(int a, int b) {
+    return a + b;
+}
+
+static long scale(long x, int factor) {
+    long y = x * factor;
+    y += factor << 2 | 1;
+    return y > 100 ? 100 : y;
+}
+
+int helper(void) {
+    int i;
+    int sum = 0;
+    for (i = 0; i < 10; ++i) {
+        if (i % 2 == 0)
+            continue;
+        else if (i == 7)
+            break;
+        sum = add(sum, i);
+    }
+    do {
+        sum -= 3;
+    } while (sum > 0 && !(sum & 1));
+    while (count < 5)
+        ++count;
+    {
+        int nested = helper() + add(1, 2) * -sum;
+        nested = nested, sum = nested;
+    }
+    ;
+    return sum >= 0 ? sum : -sum;
+}
+
+int main(void) {
+    helper();
+    int x = add(helper(), scale(2, 3));
+    x = x ^ 0 || x <= 3 && x != 4;
+    return x;
+}
@@ -0,0 +1,46 @@
+// Prints a tree the way "gardenia --no-color FILE" does, but built another way, for modes.sh to compare:
+//
+//   astdump IMAGE            from a binary AST image, as written by --emit-ast=bin
+//   astdump --expand FILE    from a parse with the function bodies skipped, each of them expanded after
+
+#include <string>
+
+#include "astfile.h"
+#include "gardenia.h"
+#include "source.h"
+
+using std::string;
+
+int main(int argc, char* argv[]) {
+    string arg = argc > 1 ? argv[1] : "";
+    try {
+        unique_ptr<Program> program;
+        if (arg == "--expand" && argc > 2) {
+            Source source(argv[2]);
+            ParseOptions options;
+            options.signatures_only = true;
+            ParseResult result = parse(source.view(), options);
+            if (!result) {
+                throw result.diagnostics[0];
+            }
+            program = std::move(result.program);
+            for (AST* decl : program->decls) {
+                if (decl->kind == NK::FUNCTION) {
+                    expand(*program, static_cast<Function*>(decl), source.view());
+                }
+            }
+        } else if (argc == 2) {
+            AstFile file(arg);
+            program = read_ast(file.view());
+        } else {
+            cerr << "usage: astdump IMAGE | astdump --expand FILE\n";
+            return 2;
+        }
+        print_program(*program, standard_output(), false);
+    } catch (const CompileError& e) {
+        standard_output().flush();
+        cerr << error_text(e, false);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+int f(void);
+int g(int a, int b);
+
+int main(void) {
+    f();
+    int x = f() + g(f(), 2);
+    return g(x, f());
+}
@@ -0,0 +1,10 @@
+int before(void) {
+    return 1;
+}
+
+int main(void) {
+    int a = before();
+    return a +;
+}
+
+int after;
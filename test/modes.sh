@@ -0,0 +1,141 @@
+#!/bin/bash
+# Checks that every way of getting a tree gives the same one as a plain run of "gardenia --no-color FILE":
+# --pipeline, --parallel, cold and warm runs with --cache-dir (also under a low --max-nesting), --lex
+# through each of them, the JSON and binary formats from each of them, a binary image read back, lazily
+# parsed bodies expanded, and several files at once on one and on many workers. Where FILE has a .txt
+# or .json next to it, the plain run must also give exactly that.
+#
+#   modes.sh GARDENIA ASTDUMP FILE...
+#
+# On a file with an error, the modes that build the whole program before printing stop without the
+# declarations before the error, so only the error and the exit status are compared for them.
+
+gardenia=$1
+astdump=$2
+shift 2
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+# run NAME COMMAND...: keep the output, the errors and the exit status of COMMAND as $tmp/NAME.*
+run() {
+    local name=$1
+    shift
+    "$@" >"$tmp/$name.out" 2>"$tmp/$name.err"
+    echo $? >"$tmp/$name.status"
+}
+
+# same WHAT A B [all|errors|output]: whether runs A and B agree, on everything,
+# on the errors and status only, or on the output and status only
+same() {
+    local what=$1 a=$2 b=$3 parts=${4:-all}
+    local list="out err status"
+    [ "$parts" = errors ] && list="err status"
+    [ "$parts" = output ] && list="out status"
+    for part in $list; do
+        if ! cmp -s "$tmp/$a.$part" "$tmp/$b.$part"; then
+            echo "FAIL: $what: the $part differs"
+            diff "$tmp/$a.$part" "$tmp/$b.$part" | head -20
+            failed=1
+            return
+        fi
+    done
+}
+
+for file in "$@"; do
+    name=$(basename "$file")
+    g="$gardenia --no-color"
+    rm -rf "$tmp/cache"
+
+    run plain $g "$file"
+    parts=all
+    if [ "$(cat "$tmp/plain.status")" != 0 ]; then
+        parts=errors
+    fi
+    # the expected output, if there is one next to the file
+    if [ -f "${file%.c}.txt" ] && ! cmp -s "${file%.c}.txt" "$tmp/plain.out"; then
+        echo "FAIL: $name: not as in $(basename "${file%.c}.txt")"
+        diff "${file%.c}.txt" "$tmp/plain.out" | head -20
+        failed=1
+    fi
+    run pipeline $g --pipeline "$file"
+    same "$name --pipeline" plain pipeline
+    run parallel1 $g --parallel -j1 "$file"
+    same "$name --parallel -j1" plain parallel1 $parts
+    run parallel4 $g --parallel -j4 "$file"
+    same "$name --parallel -j4" plain parallel4 $parts
+    run cold $g --cache-dir "$tmp/cache" "$file"
+    same "$name cold cache" plain cold $parts
+    run warm $g --cache-dir "$tmp/cache" "$file"
+    same "$name warm cache" plain warm $parts
+    # the cache must not let a tree past a lower nesting limit through
+    run nesting $g --max-nesting 2 "$file"
+    run nesting_cold $g --max-nesting 2 --cache-dir "$tmp/cache" "$file"
+    same "$name --max-nesting 2, cold cache" nesting nesting_cold errors
+    run nesting_warm $g --max-nesting 2 --cache-dir "$tmp/cache" "$file"
+    same "$name --max-nesting 2, warm cache" nesting nesting_warm errors
+
+    run lex $g --lex "$file"
+    run lex_pipeline $g --lex --pipeline "$file"
+    same "$name --lex --pipeline" lex lex_pipeline $parts
+    run lex_parallel $g --lex --parallel -j4 "$file"
+    same "$name --lex --parallel" lex lex_parallel $parts
+    run lex_warm $g --lex --cache-dir "$tmp/cache" "$file"
+    same "$name --lex, warm cache" lex lex_warm $parts
+
+    run json $g --emit-ast=json "$file"
+    if [ -f "${file%.c}.json" ] && ! cmp -s "${file%.c}.json" "$tmp/json.out"; then
+        echo "FAIL: $name: JSON not as in $(basename "${file%.c}.json")"
+        diff "${file%.c}.json" "$tmp/json.out" | head -20
+        failed=1
+    fi
+    run json_parallel $g --emit-ast=json --parallel -j4 "$file"
+    same "$name JSON, --parallel" json json_parallel $parts
+    run json_warm $g --emit-ast=json --cache-dir "$tmp/cache" "$file"
+    same "$name JSON, warm cache" json json_warm $parts
+    if command -v python3 >/dev/null && [ $parts = all ]; then
+        if ! python3 -c 'import json, sys; [json.loads(line) for line in sys.stdin]' <"$tmp/json.out"; then
+            echo "FAIL: $name JSON: not valid"
+            failed=1
+        fi
+    fi
+
+    run bin $g --emit-ast=bin "$file"
+    run bin_parallel $g --emit-ast=bin --parallel -j4 "$file"
+    same "$name binary, --parallel" bin bin_parallel $parts
+    run bin_warm $g --emit-ast=bin --cache-dir "$tmp/cache" "$file"
+    same "$name binary, warm cache" bin bin_warm $parts
+    if [ $parts = all ]; then
+        cp "$tmp/bin.out" "$tmp/image"
+        run image "$astdump" "$tmp/image"
+        same "$name binary image read back" plain image
+        run n_ary $g --n-ary "$file"
+        run n_ary_bin $g --n-ary --emit-ast=bin "$file"
+        cp "$tmp/n_ary_bin.out" "$tmp/image"
+        run n_ary_image "$astdump" "$tmp/image"
+        same "$name --n-ary binary image read back" n_ary n_ary_image
+        run expand "$astdump" --expand "$file"
+        same "$name bodies expanded" plain expand
+    fi
+done
+
+# Several files at once: each one's output under its name, in the order given.
+if [ $# -gt 1 ]; then
+    : >"$tmp/each.out"
+    status=0
+    for file in "$@"; do
+        echo "$file" >>"$tmp/each.out"
+        $gardenia --no-color "$file" >>"$tmp/each.out" 2>/dev/null || status=1
+    done
+    echo $status >"$tmp/each.status"
+    run all1 $gardenia --no-color -j1 "$@"
+    run all4 $gardenia --no-color -j4 "$@"
+    same "several files, -j1" each all1 output
+    same "several files, -j4" each all4 output
+    same "several files, -j4 against -j1" all1 all4
+fi
+
+if [ $failed = 0 ]; then
+    echo "all modes agree on $# file(s)"
+fi
+exit $failed
@@ -0,0 +1,165 @@
+// Checks reparse() against a full parse of the same text over random edits.
+//
+//   reparse-test FILE [--seed N] [--steps N]
+//
+// Each step makes one or two edits to the text: ranges deleted, snippets inserted (tokens, comments,
+// whole declarations), or pieces and lines of the text copied elsewhere. The program is brought up to date with
+// reparse() and compared with a parse of the new text: the same tree, spans and error, if any, and on an
+// error the program is left as it was. The parts of the program must not outnumber its declarations.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "gardenia.h"
+#include "source.h"
+#include "driver.h"
+#include "incremental.h"
+
+using std::string;
+
+static uint64_t state;
+
+// splitmix64, as in gen.cc
+static uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static size_t below(size_t n) { return n ? static_cast<size_t>(next() % n) : 0; }
+
+static constexpr std::string_view snippets[] = {
+    ";", "{", "}", "(", ")", "\n", " ", "x", "0", "+", "/*", "*/", "//", "/* comment */", "// comment\n",
+    "int x;\n", "f();", "return 1;", "int f(void) { return 1; }\n", "static long g = 2;\n", "\"s\"", "'c'",
+};
+
+static string dump(const Program& program) {
+    string ret;
+    {
+        Output out(ret);
+        Options options;
+        options.color = false;
+        emit(program, options, out);
+    }
+    for (const SourceRange& s : program.spans) {
+        ret += std::to_string(s.offset) + ' ' + std::to_string(s.length) + ' ' + std::to_string(s.row) + ' '
+            + std::to_string(s.col) + '\n';
+    }
+    return ret;
+}
+
+// Edits to "text", sorted and apart from each other, and the text after them.
+static vector<Edit> random_edits(const string& text, string& after) {
+    vector<Edit> edits;
+    vector<string> inserted;
+    size_t count = 1 + below(2);
+    size_t from = 0;
+    for (size_t k = 0; k != count && from <= text.size(); ++k) {
+        size_t offset = from + below(text.size() - from + 1);
+        size_t removed = 0;
+        string piece;
+        switch (below(4)) {
+            case 0:
+                removed = std::min(below(40), text.size() - offset);
+                break;
+            case 1:
+                piece = snippets[below(std::size(snippets))];
+                break;
+            case 2: {
+                size_t at = below(text.size());
+                piece = text.substr(at, below(80));
+                break;
+            }
+            default: {
+                // a whole line moved to the start of another, which more often still parses
+                size_t at = text.rfind('\n', below(text.size()));
+                at = at == string::npos ? 0 : at + 1;
+                piece = text.substr(at, text.find('\n', at) - at + 1);
+                size_t line = offset ? text.rfind('\n', offset - 1) : string::npos;
+                offset = std::max(from, line == string::npos ? 0 : line + 1);
+            }
+        }
+        edits.push_back({offset, removed, piece.size()});
+        inserted.push_back(piece);
+        from = offset + removed + 1;
+    }
+    after.clear();
+    size_t pos = 0;
+    for (size_t k = 0; k != edits.size(); ++k) {
+        after.append(text, pos, edits[k].offset - pos);
+        after += inserted[k];
+        pos = edits[k].offset + edits[k].removed;
+    }
+    after.append(text, pos);
+    return edits;
+}
+
+int main(int argc, char* argv[]) {
+    string file;
+    uint64_t seed = 1;
+    size_t steps = 500;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--steps" && i + 1 < argc) {
+            steps = strtoull(argv[++i], nullptr, 10);
+        } else {
+            file = arg;
+        }
+    }
+    state = seed;
+    string text;
+    {
+        Source source(file);
+        text = source.view();
+    }
+    ParseOptions options;
+    options.jobs = 2;  // so that the declarations start out in parts
+    ParseResult start = parse(text, options);
+    if (!start) {
+        cerr << file << ": " << error_text(start.diagnostics[0], false);
+        return 1;
+    }
+    unique_ptr<Program> program = std::move(start.program);
+    size_t failed = 0;
+    for (size_t step = 0; step != steps; ++step) {
+        string after;
+        vector<Edit> edits = random_edits(text, after);
+        ParseResult full = parse(after);
+        string before = dump(*program);
+        try {
+            reparse(*program, after, edits);
+            if (!full) {
+                cerr << "step " << step << ": reparse() passed where a full parse failed with "
+                     << error_text(full.diagnostics[0], false);
+                return 1;
+            }
+            if (dump(*program) != dump(*full.program)) {
+                cerr << "step " << step << ": reparse() differs from a full parse\n";
+                return 1;
+            }
+            text = std::move(after);
+        } catch (const CompileError& e) {
+            ++failed;
+            if (full || error_text(e, false) != error_text(full.diagnostics[0], false)) {
+                cerr << "step " << step << ": reparse() failed with " << error_text(e, false);
+                return 1;
+            }
+            if (dump(*program) != before) {
+                cerr << "step " << step << ": the program changed on an error\n";
+                return 1;
+            }
+        }
+        if (program->parts.size() > program->decls.size()) {
+            cerr << "step " << step << ": " << program->parts.size() << " parts for "
+                 << program->decls.size() << " declarations\n";
+            return 1;
+        }
+    }
+    cout << steps << " steps, " << failed << " with an error\n";
+    return 0;
+}